@@ -1,357 +1,542 @@
 
 #include <iostream>
 #include <string>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdarg>
 #include <cstdlib>
+#include <cstdio>
 #include <ctime>
 #include <random>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <chrono>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <utility>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "engine.h"
 using namespace std;
-
-class Card {
+using namespace solitaire;
+
+// Console instrumentation, built with -DSOLITAIRE_STATS. Every command,
+// board redraw and win check is timed into an HDR-style histogram (eight
+// linear sub-buckets per power of two, so a bucket is within 12.5% of the
+// values in it) and charged with the heap allocations it made. Without the
+// flag the class, the allocation hooks and every SOLITAIRE_MEASURE vanish.
+#ifdef SOLITAIRE_STATS
+class Instrumentation {
 public:
-    static const int Hearts = 0;
-    static const int Diamonds = 1;
-    static const int Clubs = 2;
-    static const int Spades = 3;
-
-    static const int Ace = 1;
-    static const int Two = 2;
-    static const int Three = 3;
-    static const int Four = 4;
-    static const int Five = 5;
-    static const int Six = 6;
-    static const int Seven = 7;
-    static const int Eight = 8;
-    static const int Nine = 9;
-    static const int Ten = 10;
-    static const int Jack = 11;
-    static const int Queen = 12;
-    static const int King = 13;
-
-    Card(int s, int r) : suit(s), rank(r), faceUp(false) {}
-
-    int getSuit() const { return suit; }
-    int getRank() const { return rank; }
-    bool isFaceUp() const { return faceUp; }
-    void flip() { faceUp = true; }
-    int getColor() const {
-        return (suit == Hearts || suit == Diamonds) ? 1 : 0; // 1 for red, 0 for black
-    }
-    string toString() const {
-        const char* suits[] = { "Hearts", "Diamonds", "Clubs", "Spades" };
-        const char* ranks[] = { "", "Ace", "Two", "Three", "Four", "Five", "Six", "Seven", "Eight", "Nine", "Ten", "Jack", "Queen", "King" };
-        return ranks[rank] + string((suit == Hearts || suit == Diamonds) ? " (red)" : " (black)") + " " + suits[suit];
-    }
-
-    string abbreviated() const {
-        const char* suits[] = { "H", "D", "C", "S" }; // Hearts, Diamonds, Clubs, Spades
-        const char* ranks[] = { "", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
-        return ranks[rank] + string(suits[suit]);
-    }
+    enum Op {
+        Parse, Render, WinCheck, StockToWaste, WasteToFoundation, WasteToTableau,
+        TableauToFoundation, TableauToTableau, Undo, Solve, Hint, Memory, Report, Restart, Snapshot, Auto, Invalid, OpCount
+    };
 
-private:
-    int suit;
-    int rank;
-    bool faceUp;
-};
+    static const int SubBits = 3;
+    static const int Powers = 40; // up to ~2^40 ns, about 18 minutes
+    static const int Buckets = Powers << SubBits;
 
-class Linkedlist {
-public:
-    Card* card;
-    Linkedlist* next;
+    // Bumped by the global operator new below; relaxed, the simulator allocates from many threads
+    static atomic<uint64_t> allocations;
+    static atomic<uint64_t> allocatedBytes;
 
-    Linkedlist(Card* c) : card(c), next(nullptr) {}
-};
+    static Instrumentation& global() {
+        static Instrumentation instance;
+        return instance;
+    }
 
-class Stack {
-public:
-    Stack() : top(nullptr) {}
+    // Times the enclosing block and charges it with the allocations made inside
+    class Scope {
+    public:
+        Scope(Op o) : op(o), allocationsBefore(allocations.load(memory_order_relaxed)), begin(chrono::steady_clock::now()) {}
 
-    ~Stack() {
-        while (!isEmpty()) {
-            pop();
+        ~Scope() {
+            uint64_t nanos = uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+            global().record(op, nanos, allocations.load(memory_order_relaxed) - allocationsBefore);
         }
-    }
 
-    void push(Card* card) {
-        Linkedlist* newLinkedlist = new Linkedlist(card);
-        newLinkedlist->next = top;
-        top = newLinkedlist;
-    }
+    private:
+        Op op;
+        uint64_t allocationsBefore;
+        chrono::steady_clock::time_point begin;
+    };
 
-    Card* pop() {
-        if (isEmpty()) return nullptr;
-        Linkedlist* temp = top;
-        Card* card = top->card;
-        top = top->next;
-        delete temp;
-        return card;
+    void record(Op op, uint64_t nanos, uint64_t allocated) {
+        Counter& c = counters[op];
+        c.count++;
+        c.nanos += nanos;
+        c.maxNanos = max(c.maxNanos, nanos);
+        c.allocations += allocated;
+        c.histogram[bucketOf(nanos)]++;
     }
 
-    Card* peek() const {
-        return top ? top->card : nullptr;
+    static int bucketOf(uint64_t nanos) {
+        if (nanos < (uint64_t(1) << SubBits)) return int(nanos);
+        int power = 63 - __builtin_clzll(nanos);
+        int bucket = ((power - SubBits + 1) << SubBits) + int((nanos >> (power - SubBits)) & ((1 << SubBits) - 1));
+        return min(bucket, Buckets - 1);
     }
 
-    bool isEmpty() const {
-        return top == nullptr;
+    // Largest value that falls into the bucket
+    static uint64_t upperBound(int bucket) {
+        if (bucket < (1 << SubBits)) return uint64_t(bucket);
+        int power = (bucket >> SubBits) + SubBits - 1;
+        uint64_t sub = uint64_t(bucket & ((1 << SubBits) - 1));
+        return ((uint64_t(1) << SubBits | sub) << (power - SubBits)) + (uint64_t(1) << (power - SubBits)) - 1;
     }
 
-    Linkedlist* getTopLinkedlist() const {
-        return top;
+    uint64_t percentile(Op op, double fraction) const {
+        const Counter& c = counters[op];
+        uint64_t target = uint64_t(c.count * fraction), seen = 0;
+        for (int i = 0; i < Buckets; ++i) {
+            seen += c.histogram[i];
+            if (seen > target) return min(upperBound(i), c.maxNanos);
+        }
+        return c.maxNanos;
     }
 
-    int count() const {
-        Linkedlist* current = top;
-        int count = 0;
-        while (current) {
-            count++;
-            current = current->next;
+    void report(ostream& out) const {
+        out << left << setw(22) << "operation" << right << setw(8) << "count" << setw(12) << "mean us"
+            << setw(12) << "p50 us" << setw(12) << "p99 us" << setw(12) << "max us" << setw(10) << "allocs" << "\n";
+        for (int op = 0; op < OpCount; ++op) {
+            const Counter& c = counters[op];
+            if (!c.count) continue;
+            out << left << setw(22) << names[op] << right << setw(8) << c.count
+                << setw(12) << c.nanos / 1000.0 / c.count << setw(12) << percentile(Op(op), 0.50) / 1000.0
+                << setw(12) << percentile(Op(op), 0.99) / 1000.0 << setw(12) << c.maxNanos / 1000.0
+                << setw(10) << c.allocations << "\n";
         }
-        return count;
+        out << "Heap allocations: " << allocations.load() << " (" << allocatedBytes.load() << " bytes)\n";
     }
 
-private:
-    Linkedlist* top;
-};
-
-class Deck {
-public:
-    Deck() {
-        for (int suit = 0; suit < 4; ++suit) {
-            for (int rank = 1; rank <= 13; ++rank) {
-                Card* card = new Card(suit, rank);
-                stack.push(card);
+    // One JSON object; histograms list only non-empty buckets as [upper bound ns, count]
+    void writeJson(ostream& out) const {
+        out << "{\"heapAllocations\":" << allocations.load() << ",\"heapBytes\":" << allocatedBytes.load() << ",\"operations\":{";
+        bool first = true;
+        for (int op = 0; op < OpCount; ++op) {
+            const Counter& c = counters[op];
+            if (!c.count) continue;
+            out << (first ? "" : ",") << "\"" << names[op] << "\":{\"count\":" << c.count << ",\"totalNs\":" << c.nanos
+                << ",\"maxNs\":" << c.maxNanos << ",\"p50Ns\":" << percentile(Op(op), 0.50)
+                << ",\"p99Ns\":" << percentile(Op(op), 0.99) << ",\"allocations\":" << c.allocations << ",\"histogram\":[";
+            bool firstBucket = true;
+            for (int i = 0; i < Buckets; ++i) {
+                if (!c.histogram[i]) continue;
+                out << (firstBucket ? "" : ",") << "[" << upperBound(i) << "," << c.histogram[i] << "]";
+                firstBucket = false;
             }
+            out << "]}";
+            first = false;
         }
-        shuffle();
+        out << "}}\n";
     }
 
-    ~Deck() {
-        while (!stack.isEmpty()) {
-            delete stack.pop();
+    bool isEmpty() const {
+        for (int op = 0; op < OpCount; ++op) {
+            if (counters[op].count) return false;
         }
+        return true;
     }
 
-    void shuffle() {
-        Card* cards[52];
-        int index = 0;
-
-        while (!stack.isEmpty()) {
-            cards[index++] = stack.pop();
-        }
+private:
+    struct Counter {
+        uint64_t count = 0;
+        uint64_t nanos = 0;
+        uint64_t maxNanos = 0;
+        uint64_t allocations = 0;
+        uint64_t histogram[Buckets] = {};
+    };
 
-        random_device rd;
-        mt19937 g(rd());
-        for (int i = 0; i < 52; ++i) {
-            int j = i + (rand() % (52 - i)); // Random index for shuffle
-            swap(cards[i], cards[j]);
-        }
+    Instrumentation() {}
 
-        for (int i = 0; i < 52; ++i) {
-            stack.push(cards[i]);
-        }
+    // The exit-time dump: runs on normal return and on exit() alike
+    ~Instrumentation() {
+        if (!isEmpty()) writeJson(cerr);
     }
 
-    Card* deal() {
-        return stack.pop();
-    }
+    static const char* const names[OpCount];
+    Counter counters[OpCount];
+};
 
-    int cardsRemaining() const {
-        return stack.count();
-    }
+atomic<uint64_t> Instrumentation::allocations(0);
+atomic<uint64_t> Instrumentation::allocatedBytes(0);
+const char* const Instrumentation::names[Instrumentation::OpCount] = {
+    "parse", "render", "win-check", "mv", "wf", "wt", "mt-foundation", "mt-tableau", "undo", "solve", "hint", "mem", "stats", "restart", "snapshot", "auto", "invalid"
+};
 
-private:
-    Stack stack;
-    Stack tableauStacks[7];
+// Kept out of line so GCC does not flag the malloc/free pairing as mismatched
+__attribute__((noinline)) void* operator new(size_t size) {
+    Instrumentation::allocations.fetch_add(1, memory_order_relaxed);
+    Instrumentation::allocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
 
-};
+__attribute__((noinline)) void* operator new[](size_t size) {
+    return operator new(size);
+}
 
-class Tableau {
-public:
-    Tableau(Deck& deck) {
-        for (int i = 0; i < 7; ++i) {
-            for (int j = 0; j <= i; ++j) {
-                Card* card = deck.deal();
-                if (j == i) {
-                    card->flip();  // Only the top card is face up
-                }
-                tableauStacks[i].push(card);
-            }
-        }
-    }
-    //   Card* peek(int index) {
-    //    return tableauStacks[index].getTopLinkedlist()->card; // Assuming getTopLinkedlist() returns a pointer to a struct that contains a Card* pointer
-    //}
-    Card* peek(int index) {
-        if (index < 0 || index >= 7) {
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
 
-            throw std::out_of_range("Index out of bounds");
-        }
+__attribute__((noinline)) void operator delete[](void* p) noexcept {
+    free(p);
+}
 
-        return tableauStacks[index].getTopLinkedlist()->card;
-    }
-    ~Tableau() {
-        for (int i = 0; i < 7; ++i) {
-            while (!tableauStacks[i].isEmpty()) {
-                delete tableauStacks[i].pop();
-            }
-        }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+#define SOLITAIRE_MEASURE(op) Instrumentation::Scope measureScope(Instrumentation::op)
+#else
+#define SOLITAIRE_MEASURE(op) ((void)0)
+#endif
+
+// Fixed-size nodes carved out of blocks of BlockSize. Released nodes go on a
+// free list and are handed out again, so once the pool has grown to the
+// working set acquire/release never touch the heap. The first block is
+// allocated up front; getHeapAllocations() counts every block since.
+template <typename T, int BlockSize = 256>
+class NodePool {
+public:
+    NodePool() : blocks(nullptr), freeList(nullptr), heapAllocations(0), inUse(0) {
+        grow();
     }
-    Card* peekTopCard(int index) {
-        if (tableauStacks[index].isEmpty()) { // Replace with your condition to check if empty
-            return nullptr; // Or throw an error
+
+    ~NodePool() {
+        while (blocks) {
+            Block* next = blocks->next;
+            delete blocks;
+            blocks = next;
         }
-        return tableauStacks[index].pop(); // Assuming you're using a stack-like structure
     }
-    void display() const {
-        cout << "Tableau\n";
-        for (int i = 0; i < 7; ++i) {
-            cout << "\t" << (i + 1);
-        }
-        cout << "\n";
 
-        for (int i = 0; i < 7; ++i) {
-            Linkedlist* current = tableauStacks[i].getTopLinkedlist();
-            cout << "\t";
-            while (current) {
-                if (current->card->isFaceUp()) {
-                    cout << current->card->abbreviated();
-                }
-                else {
-                    cout << "x"; // Indicate face-down cards
-                }
-                cout << "\t";
-                current = current->next;
-            }
-            cout << "\n";
-        }
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    template <typename... Args>
+    T* acquire(Args&&... args) {
+        if (!freeList) grow();
+        Slot* slot = freeList;
+        freeList = slot->next;
+        ++inUse;
+        return new (slot->storage) T(std::forward<Args>(args)...);
     }
 
-    Card* removeTopCard(int index) {
-        if (index < 0 || index >= 7) return nullptr;
-        Card* card = tableauStacks[index].pop();
-        if (tableauStacks[index].isEmpty()) return card; // No cards left to reveal
-        tableauStacks[index].peek()->flip(); // Flip the new top card if it exists
-        return card;
+    void release(T* node) {
+        node->~T();
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = freeList;
+        freeList = slot;
+        --inUse;
     }
 
-    void pushCard(int index, Card* card) {
-        if (index < 0 || index >= 7 || card == nullptr) return;
-        tableauStacks[index].push(card);
-        if (card->isFaceUp()) { // If moving a face-up card, check the new top
-            if (!tableauStacks[index].isEmpty()) {
-                tableauStacks[index].peek()->flip(); // Flip the new top card
-            }
+    uint64_t getHeapAllocations() const { return heapAllocations; }
+    int getInUse() const { return inUse; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Block {
+        Slot slots[BlockSize];
+        Block* next;
+    };
+
+    void grow() {
+        Block* block = new Block;
+        ++heapAllocations;
+        block->next = blocks;
+        blocks = block;
+        for (int i = BlockSize - 1; i >= 0; --i) {
+            block->slots[i].next = freeList;
+            freeList = &block->slots[i];
         }
     }
 
-private:
-    Stack tableauStacks[7];
+    Block* blocks;
+    Slot* freeList;
+    uint64_t heapAllocations;
+    int inUse;
 };
 
-class Foundation {
+// Draws the console board. Each frame is formatted line by line into a
+// fixed buffer and compared with the one before it; a pile is re-formatted
+// only when its cards changed. On a terminal the board is pinned above a
+// scrolling region, so command output scrolls underneath it, and only the
+// lines that changed are rewritten, each behind an ANSI cursor move. Piped
+// output gets the whole frame as before. Either way a frame leaves in one
+// write(2).
+class Renderer {
 public:
-    Foundation() {
-        for (int i = 0; i < 4; ++i) {
-            foundationStacks[i] = Stack();
+    static const int Lines = 18;
+    static const int LineSize = 96;
+
+    Renderer(int fd = STDOUT_FILENO) : fd(fd), terminal(isatty(fd) != 0), drawn(false), previous(), frames(0),
+        bytes(0), writes(0) {}
+
+    // Gives the terminal its whole screen back
+    ~Renderer() {
+        if (terminal && drawn) {
+            send("\x1b" "7\x1b[r\x1b" "8", 8);
         }
     }
-    Card* peek(int index) {
-        return foundationStacks[index].getTopLinkedlist()->card; // Assuming getTopLinkedlist() returns a pointer to a struct that contains a Card* pointer
-    }
 
-    bool isEmpty() const {
-        // Check if any foundation stack is empty
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    void draw(const GameState& s) {
+        bool changed[Lines];
+        const char* suits[] = { "C", "H", "S", "D" }; // C: Clubs, H: Hearts, S: Spades, D: Diamonds
+        setLine(0, changed, "");
+        setLine(1, changed, "--- Game State ---");
+        setLine(2, changed, "Foundation");
         for (int i = 0; i < 4; ++i) {
-            if (!foundationStacks[i].isEmpty()) {
-                return false;
+            if (drawn && s.foundation[i] == previous.foundation[i]) {
+                changed[3 + i] = false;
+                continue;
+            }
+            char line[LineSize];
+            int n = snprintf(line, sizeof(line), "\t%s", suits[i]);
+            if (s.foundation[i]) {
+                n += formatCard(line + n, uint8_t(Card(i, s.foundation[i]).getCode() | Card::FaceUpBit));
+            }
+            else {
+                line[n++] = ' ';
             }
+            line[n] = 0;
+            setLine(3 + i, changed, line);
         }
-        return true;
-    }
-    void moveToFoundation(Card* card) {
-        // If no card is provided, exit the function
-        if (card == nullptr) return;
-
-        // Get the index of the foundation pile based on the card's suit
-        int suitIndex = card->getSuit();
-
-        // Check if the foundation stack for the card's suit is empty
-        if (foundationStacks[suitIndex].isEmpty()) {
-            // If the foundation is empty, only an Ace can be placed
-            if (card->getRank() == Card::Ace) {
-                foundationStacks[suitIndex].push(card);
+        setLine(7, changed, "Tableau");
+        setLine(8, changed, "\t1\t2\t3\t4\t5\t6\t7");
+        for (int i = 0; i < GameState::TableauPiles; ++i) {
+            int count = s.tableauCount[i];
+            if (drawn && count == previous.tableauCount[i] && memcmp(s.tableau[i], previous.tableau[i], count) == 0) {
+                changed[9 + i] = false;
+                continue;
+            }
+            char line[LineSize];
+            int n = 0;
+            line[n++] = '\t';
+            for (int j = count - 1; j >= 0; --j) {
+                Card card(s.tableau[i][j]);
+                n += card.isFaceUp() ? formatCard(line + n, card.getCode()) : (line[n] = 'x', 1);
+                line[n++] = '\t';
             }
+            line[n] = 0;
+            setLine(9 + i, changed, line);
+        }
+        if (!drawn || s.wasteTop() != previous.wasteTop()) {
+            string waste = "Waste: " + (s.wasteCount ? Card(s.wasteTop()).toString() : string("Empty"));
+            setLine(16, changed, waste.c_str());
         }
         else {
-            // Get the top card of the foundation stack
-            Card* topCard = foundationStacks[suitIndex].peek();
+            changed[16] = false;
+        }
+        setLine(17, changed, "-------------------");
 
-            // Check if the card can follow the top card (must be the next in rank)
-            if (topCard->getRank() == card->getRank() - 1) {
-                foundationStacks[suitIndex].push(card);
+        char out[Lines * (LineSize + 16) + 32];
+        int n = 0;
+        if (!terminal) {
+            for (int i = 0; i < Lines; ++i) {
+                n += snprintf(out + n, sizeof(out) - size_t(n), "%s\n", frame[i]);
             }
         }
-    }
-
-    void display() const {
-        cout << "Foundation\n";
-        const char* suits[] = { "C", "H", "S", "D" }; // C: Clubs, H: Hearts, S: Spades, D: Diamonds
-        for (int i = 0; i < 4; ++i) {
-            cout << "\t" << suits[i];
-            if (!foundationStacks[i].isEmpty()) {
-                cout << foundationStacks[i].peek()->abbreviated();
+        else if (!drawn) {
+            // Clear the screen, draw everything, then scroll only below the board
+            n += snprintf(out + n, sizeof(out) - size_t(n), "\x1b[2J\x1b[H");
+            for (int i = 0; i < Lines; ++i) {
+                n += snprintf(out + n, sizeof(out) - size_t(n), "%s\n", frame[i]);
             }
-            else {
-                cout << " ";
+            n += snprintf(out + n, sizeof(out) - size_t(n), "\x1b[%d;r\x1b[%d;1H", Lines + 1, Lines + 1);
+        }
+        else {
+            for (int i = 0; i < Lines; ++i) {
+                if (!changed[i]) continue;
+                if (n == 0) n += snprintf(out, sizeof(out), "\x1b" "7");
+                n += snprintf(out + n, sizeof(out) - size_t(n), "\x1b[%d;1H\x1b[2K%s", i + 1, frame[i]);
             }
-            cout << "\n";
+            if (n) n += snprintf(out + n, sizeof(out) - size_t(n), "\x1b" "8");
+        }
+        previous = s;
+        drawn = true;
+        ++frames;
+        if (n) send(out, n);
+    }
+
+    bool isTerminal() const { return terminal; }
+    uint64_t getFrames() const { return frames; }
+    uint64_t getBytes() const { return bytes; }
+    uint64_t getWrites() const { return writes; }
+
+private:
+    // Rank and suit as Card::abbreviated spells them, without the string
+    static int formatCard(char* out, uint8_t code) {
+        const char* suits = "HDCS";
+        const char* ranks[] = { "", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
+        Card card(code);
+        int n = snprintf(out, 4, "%s", ranks[card.getRank()]);
+        out[n++] = suits[card.getSuit()];
+        return n;
+    }
+
+    void setLine(int index, bool* changed, const char* text) {
+        changed[index] = !drawn || strcmp(frame[index], text) != 0;
+        if (changed[index]) {
+            snprintf(frame[index], LineSize, "%s", text);
         }
     }
 
-    int count() const {
-        int total = 0;
-        for (const auto& stack : foundationStacks) {
-            total += stack.count();
+    // cout may hold text printed since the last frame; it has to go first
+    void send(const char* data, int size) {
+        cout.flush();
+        while (size > 0) {
+            ssize_t written = ::write(fd, data, size_t(size));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            data += written;
+            size -= int(written);
+            bytes += uint64_t(written);
+            ++writes;
         }
-        return total;
     }
 
-private:
-    Stack foundationStacks[4];
+    int fd;
+    bool terminal;
+    bool drawn;
+    GameState previous;
+    char frame[Lines][LineSize];
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t writes;
 };
 
-class Solitaire {
+template <typename Rules>
+class BasicSolitaire {
 public:
-    Solitaire() : deck(), tableau(deck), foundations(), wasteCard(nullptr), undoStack(nullptr) {
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef BasicSolver<Rules> Solver;
+    typedef BasicParallelSolver<Rules> ParallelSolver;
+    typedef BasicHintEngine<Rules> HintEngine;
+    typedef BasicAutoFoundation<Rules> AutoFoundation;
+
+    static const int DefaultHintMillis = 5;
+
+    BasicSolitaire() : BasicSolitaire(randomDealNumber()) {}
+
+    // Only sets the game up; play() runs the console
+    BasicSolitaire(uint64_t dealNumber) : state(), deck(state, dealNumber), tableau(state, deck), foundations(state),
+        undoPool(), undoStack(nullptr), dealNumber(dealNumber), saved(), savedDeal(0), hasSaved(false),
+        autoFoundation(false) {}
 
+    ~BasicSolitaire() {
+        clearUndo();
+    }
+
+    static uint64_t randomDealNumber() {
+        return (uint64_t(random_device()()) << 32) | random_device()();
+    }
+
+    void showBanner() {
+        // A terminal keeps the board at the top, so the command list goes underneath it
+        if (renderer.isTerminal()) displayGameState();
         cout << "-------------------------------------------------------------------\n";
-        cout << "Welcome to Nufil's Solitaire!\n";
+        cout << "Welcome to Nufil's Solitaire! (deal #" << dealNumber << ")\n";
         cout << "\nValid Commands: \n";
         cout << "\tmv - move card from Stock to Waste\n";
         cout << "\twf - move card from Waste to Foundation\n";
         cout << "\twt #T - move card from Waste to Tableau\n";
         cout << "\tmt #T - move top card from Tableau to Foundation\n";
-        cout << "\tmt #T1 #T2 - move top card from Tableau T1 to Tableau T2\n";
+        cout << "\tmt #T1 #T2 - move cards from Tableau T1 to Tableau T2\n";
         cout << "\tundo - undo last move\n";
+        cout << "\trestart [deal#] - start this deal, or another one, over\n";
+        cout << "\tsave / load - remember the current position / go back to it\n";
+        cout << "\tauto on|off - play safe foundation moves after every move\n";
+        cout << "\tsolve [threads] - check whether the current position can still be won\n";
+        cout << "\thint [ms] - suggest a next move, thinking at most ms milliseconds (default 5)\n";
+        cout << "\tmem - show undo record usage and heap allocations\n";
+        cout << "\tstats - show per-command timings (builds with -DSOLITAIRE_STATS)\n";
         cout << "\texit - exit the game\n";
         cout << "-------------------------------------------------------------------\n";
-        play();
     }
 
+    // The whole position as one struct copy
+    GameState snapshot() const {
+        return state;
+    }
+
+    // Puts back a snapshot of deal #number; the undo history no longer
+    // applies and is dropped
+    void restore(const GameState& position, uint64_t number) {
+        state = position;
+        dealNumber = number;
+        clearUndo();
+    }
+
+    // Deals again into the same storage; nothing is allocated
+    void restart(uint64_t number) {
+        dealNumber = number;
+        state.clear();
+        deck.shuffle(number);
+        tableau = Tableau(state, deck);
+        clearUndo();
+    }
+
+    // Reads commands until the game is won or the player leaves
     void play() {
+        showBanner();
         string command;
         while (true) {
-            displayGameState();
+            {
+                SOLITAIRE_MEASURE(Render);
+                displayGameState();
+            }
             cout << "Enter command: ";
             cin >> command;
 
             if (command == "mv") {
+                SOLITAIRE_MEASURE(StockToWaste);
                 moveFromStockToWaste();
             }
             else if (command == "wf") {
+                SOLITAIRE_MEASURE(WasteToFoundation);
                 moveFromWasteToFoundation();
             }
             else if (command == "wt") {
+                SOLITAIRE_MEASURE(WasteToTableau);
                 int tableauIndex;
                 cin >> tableauIndex;
                 if (cin.fail() || tableauIndex < 1 || tableauIndex > 7) {
@@ -365,76 +550,138 @@ public:
                 }
             }
             else if (command == "mt") {
-                string tableauIndex1, tableauIndex2;
-                cin >> tableauIndex1;
-                if (isdigit(tableauIndex1[0])) {
-                    if (cin >> tableauIndex2 && isdigit(tableauIndex2[0])) {
+                // One or two indices, so the rest of the line decides which move it is
+                string rest, tableauIndex1, tableauIndex2;
+                bool twoIndices;
+                {
+                    SOLITAIRE_MEASURE(Parse);
+                    getline(cin, rest);
+                    istringstream args(rest);
+                    args >> tableauIndex1;
+                    twoIndices = args >> tableauIndex2 && isdigit(tableauIndex2[0]);
+                }
+                if (!tableauIndex1.empty() && isdigit(tableauIndex1[0])) {
+                    if (twoIndices) {
+                        SOLITAIRE_MEASURE(TableauToTableau);
                         moveBetweenTableaus(stoi(tableauIndex1) - 1, stoi(tableauIndex2) - 1);
                     }
                     else {
+                        SOLITAIRE_MEASURE(TableauToFoundation);
                         moveFromTableauToFoundation(stoi(tableauIndex1) - 1);
                     }
                 }
                 else {
                     cout << "Invalid input for Tableau index. Please try again.\n";
-                    cin.clear();
-                    // Clear the input buffer manually by reading until newline
-                    while (cin.get() != '\n');
                 }
             }
             else if (command == "undo") {
+                SOLITAIRE_MEASURE(Undo);
                 undoLastMove();
             }
+            else if (command == "solve") {
+                string rest;
+                getline(cin, rest);
+                SOLITAIRE_MEASURE(Solve);
+                solve(atoi(rest.c_str()));
+            }
+            else if (command == "hint") {
+                string rest;
+                getline(cin, rest);
+                int budget = atoi(rest.c_str());
+                SOLITAIRE_MEASURE(Hint);
+                hint(budget > 0 ? budget : DefaultHintMillis);
+            }
+            else if (command == "restart") {
+                string rest;
+                getline(cin, rest);
+                SOLITAIRE_MEASURE(Restart);
+                char* end;
+                uint64_t number = strtoull(rest.c_str(), &end, 10);
+                restart(end != rest.c_str() ? number : dealNumber);
+                cout << "Restarted with deal #" << dealNumber << "\n";
+            }
+            else if (command == "save") {
+                SOLITAIRE_MEASURE(Snapshot);
+                saved = snapshot();
+                savedDeal = dealNumber;
+                hasSaved = true;
+                cout << "Position saved.\n";
+            }
+            else if (command == "load") {
+                SOLITAIRE_MEASURE(Snapshot);
+                if (hasSaved) {
+                    restore(saved, savedDeal);
+                    cout << "Saved position of deal #" << dealNumber << " restored.\n";
+                }
+                else {
+                    cout << "No position saved yet.\n";
+                }
+            }
+            else if (command == "auto") {
+                string rest, mode;
+                getline(cin, rest);
+                istringstream(rest) >> mode;
+                SOLITAIRE_MEASURE(Auto);
+                if (mode == "on" || mode == "off") {
+                    autoFoundation = mode == "on";
+                    cout << "Auto-foundation " << mode << ".\n";
+                    if (autoFoundation) playSafeMoves(false);
+                }
+                else {
+                    cout << "Invalid input for auto, use on or off. Please try again.\n";
+                }
+            }
+            else if (command == "mem") {
+                SOLITAIRE_MEASURE(Memory);
+                showMemory();
+            }
+            else if (command == "stats") {
+                SOLITAIRE_MEASURE(Report);
+                showStats();
+            }
             else if (command == "exit") {
                 cout << "Thank you for playing!\n";
                 break;
             }
             else {
+                SOLITAIRE_MEASURE(Invalid);
                 cout << "Invalid command. Please try again.\n";
             }
-            checkWinCondition();
+            Zobrist::verify(state);
+            SOLITAIRE_MEASURE(WinCheck);
+            if (checkWinCondition()) break;
         }
     }
 
 
+    // Draws Rules::Draw cards, or turns the waste over when the stock is empty and the rules allow it
     void moveFromStockToWaste() {
-        if (deck.cardsRemaining() > 0) {
-            Card* card = deck.deal();
-            card->flip(); // Flip the card face up
-            wasteCard = card;
-            addToUndoStack("Stock to Waste", card);
-            cout << "Moved from Stock to Waste: " << card->toString() << endl;
+        Move m;
+        if (!MoveGenerator::stockMove(state, m)) {
+            cout << "No cards left in the stock!\n";
+        }
+        else if (m.from == Move::StockPile) {
+            Card card = Card(state.talon[state.wasteCount + m.count - 1]); // ends up on top of the waste
+            perform(m);
+            cout << "Moved from Stock to Waste: " << card.toString() << endl;
         }
         else {
-            cout << "No cards left in the stock!\n";
+            perform(m);
+            cout << "Turned the waste over into the stock.\n";
         }
     }
 
 
     void moveFromWasteToFoundation() {
-        if (wasteCard) {
-            // Check if foundation is empty
-            if (foundations.isEmpty()) {
-                foundations.moveToFoundation(wasteCard);
-                addToUndoStack("Waste to Foundation", wasteCard);
-                wasteCard = nullptr; // Reset waste card
+        Card wasteCard(state.wasteTop());
+        if (!wasteCard.isNull()) {
+            Move m{ Move::WastePile, uint8_t(Move::FoundationPile + wasteCard.getSuit()), 1, 0 };
+            if (MoveGenerator::isLegal(state, m)) {
+                perform(m);
                 cout << "Moved from Waste to Foundation.\n";
             }
             else {
-                // Get the card currently in the foundation
-                int index = 0;
-                Card* foundationCard = foundations.peek(index); // Assuming peek() gets the top card without removing it
-
-                // Check if the waste card is opposite in color and smaller
-                if (isOppositeColor(wasteCard, foundationCard) && isSmaller(wasteCard, foundationCard)) {
-                    foundations.moveToFoundation(wasteCard);
-                    addToUndoStack("Waste to Foundation", wasteCard);
-                    wasteCard = nullptr; // Reset waste card
-                    cout << "Moved from Waste to Foundation.\n";
-                }
-                else {
-                    cout << "Invalid operation: Card must be opposite in color and smaller.\n";
-                }
+                cout << "Invalid operation: Card must be the next rank of its suit.\n";
             }
         }
         else {
@@ -442,41 +689,17 @@ public:
         }
     }
 
-    // Helper functions to check color and size
-    bool isOppositeColor(Card* wasteCard, Card* foundationCard) {
-        // Assuming Card has a method to get color
-        return (wasteCard->getColor() != foundationCard->getColor());
-    }
-
-    bool isSmaller(Card* wasteCard, Card* foundationCard) {
-        // Assuming Card has a method to get rank
-        return (wasteCard->getRank() < foundationCard->getRank());
-    }
-
 
     void moveFromWasteToTableau(int index) {
-        if (wasteCard) {
-            // Get the card currently on top of the tableau
-            Card* tableauCard = tableau.peekTopCard(index); // Assuming peekTopCard() retrieves the top card without removing it
-
-            // Check if the tableau card is valid for comparison
-            if (tableauCard) {
-                if (isOppositeColor(wasteCard, tableauCard) && isSmaller(wasteCard, tableauCard)) {
-                    tableau.pushCard(index, wasteCard);
-                    addToUndoStack("Waste to Tableau", wasteCard);
-                    wasteCard = nullptr; // Reset waste card
-                    cout << "Moved from Waste to Tableau " << (index + 1) << ".\n";
-                }
-                else {
-                    cout << "Invalid operation: Card must be opposite in color and smaller.\n";
-                }
+        if (index < 0 || index >= 7) return;
+        if (state.wasteCount) {
+            Move m{ Move::WastePile, uint8_t(index), 1, 0 };
+            if (MoveGenerator::isLegal(state, m)) {
+                perform(m);
+                cout << "Moved from Waste to Tableau " << (index + 1) << ".\n";
             }
             else {
-                // If the tableau is empty, you can move the card directly
-                tableau.pushCard(index, wasteCard);
-                addToUndoStack("Waste to Tableau", wasteCard);
-                wasteCard = nullptr; // Reset waste card
-                cout << "Moved from Waste to Tableau " << (index + 1) << ".\n";
+                cout << "Invalid operation: Card must be opposite in color and one rank lower (only a King goes on an empty column).\n";
             }
         }
         else {
@@ -486,25 +709,15 @@ public:
 
 
     void moveFromTableauToFoundation(int index) {
-        Card* card = tableau.removeTopCard(index);
-        if (card) {
-            // Check if the foundation is empty
-            if (foundations.isEmpty()) {
-                foundations.moveToFoundation(card);
-                addToUndoStack("Tableau to Foundation", card);
-                cout << "Moved card from Tableau " << (index + 1) << " to Foundation: " << card->toString() << endl;
+        Card card = tableau.peekTopCard(index);
+        if (!card.isNull()) {
+            Move m{ uint8_t(index), uint8_t(Move::FoundationPile + card.getSuit()), 1, 0 };
+            if (MoveGenerator::isLegal(state, m)) {
+                perform(m);
+                cout << "Moved card from Tableau " << (index + 1) << " to Foundation: " << card.toString() << endl;
             }
             else {
-                Card* foundationCard = foundations.peek(index); // Get the top card in the foundation
-                if (isOppositeColor(card, foundationCard) && isSmaller(card, foundationCard)) {
-                    foundations.moveToFoundation(card);
-                    addToUndoStack("Tableau to Foundation", card);
-                    cout << "Moved card from Tableau " << (index + 1) << " to Foundation: " << card->toString() << endl;
-                }
-                else {
-                    cout << "Invalid operation: Card must be opposite in color and smaller.\n";
-                    tableau.pushCard(index, card); // Put the card back to the tableau if move fails
-                }
+                cout << "Invalid operation: Card must be the next rank of its suit.\n";
             }
         }
         else {
@@ -513,118 +726,2724 @@ public:
     }
 
 
-
+    // Moves the part of the face-up run on T1 that fits on T2, if any
     void moveBetweenTableaus(int fromIndex, int toIndex) {
-        Card* card = tableau.removeTopCard(fromIndex);
-        if (card) {
-            // Get the card currently on top of the target tableau
-            Card* targetTableauCard = tableau.peekTopCard(toIndex); // Assuming peekTopCard() retrieves the top card without removing it
-
-            // Check if the target tableau card is valid for comparison
-            if (targetTableauCard) {
-                if (isOppositeColor(card, targetTableauCard) && isSmaller(card, targetTableauCard)) {
-                    tableau.pushCard(toIndex, card);
-                    addToUndoStack("Tableau to Tableau", card);
-                    cout << "Moved card from Tableau " << (fromIndex + 1) << " to Tableau " << (toIndex + 1) << ": " << card->toString() << endl;
-                }
-                else {
-                    cout << "Invalid operation: Card must be opposite in color and smaller.\n";
-                    tableau.pushCard(fromIndex, card); // Put the card back to the original tableau if move fails
-                }
+        if (tableau.peekTopCard(fromIndex).isNull() || toIndex < 0 || toIndex >= 7 || toIndex == fromIndex) {
+            cout << "No card to move from Tableau!\n";
+            return;
+        }
+
+        Move moves[MoveGenerator::MaxMoves];
+        int n = MoveGenerator::generateMoves(state, moves);
+        for (int i = 0; i < n; ++i) {
+            if (moves[i].from == fromIndex && moves[i].to == toIndex) {
+                Card card(state.tableau[fromIndex][state.tableauCount[fromIndex] - moves[i].count]);
+                perform(moves[i]);
+                cout << "Moved " << int(moves[i].count) << " card(s) from Tableau " << (fromIndex + 1) << " to Tableau " << (toIndex + 1) << ": " << card.toString() << endl;
+                return;
             }
-            else {
-                // If the target tableau is empty, you can move the card directly
-                tableau.pushCard(toIndex, card);
-                addToUndoStack("Tableau to Tableau", card);
-                cout << "Moved card from Tableau " << (fromIndex + 1) << " to Tableau " << (toIndex + 1) << ": " << card->toString() << endl;
+        }
+        cout << "Invalid operation: Card must be opposite in color and one rank lower (only a King goes on an empty column).\n";
+    }
+
+    // More than one thread runs the parallel search
+    void solve(int threads) {
+        typename Solver::Result* result = new typename Solver::Result;
+        if (threads > 1) {
+            ParallelSolver solver(threads);
+            solver.solve(state, *result);
+        }
+        else {
+            Solver solver;
+            solver.solve(state, *result);
+        }
+
+        if (result->status == Solver::Solved) {
+            cout << "Solvable in " << result->moveCount << " moves:\n";
+            for (int i = 0; i < result->moveCount; ++i) {
+                cout << "\t" << (i + 1) << ". " << result->moves[i].toCommand() << "\n";
             }
         }
+        else if (result->blocked) {
+            cout << "This position cannot be won: a card is buried under everything it could ever move to.\n";
+        }
+        else if (result->status == Solver::Unwinnable) {
+            cout << "This position cannot be won.\n";
+        }
         else {
-            cout << "No card to move from Tableau!\n";
+            cout << "Solver gave up before reaching a verdict.\n";
         }
+        cout << "Searched " << result->nodes << " positions in " << result->seconds * 1000 << " ms ("
+            << (result->seconds > 0 ? uint64_t(result->nodes / result->seconds) : 0) << " positions/s), "
+            << result->pruned << " dead ends cut off\n";
+        delete result;
     }
 
+    void hint(int millis) {
+        typename HintEngine::Hint result;
+        hints.hint(state, chrono::milliseconds(millis), result);
+        if (!result.found) {
+            cout << "No moves left.\n";
+            return;
+        }
+        cout << "Hint: " << result.move.toCommand() << " (looked " << result.depth << " moves ahead, "
+            << result.nodes << " positions in " << result.seconds * 1000 << " ms)\n";
+    }
 
+    // Takes back the last command, with the foundation moves auto-play added to it
     void undoLastMove() {
         if (!undoStack) {
             cout << "No moves to undo!\n";
             return;
         }
+        while (undoStack->automatic) undoOne();
+        undoOne();
+    }
 
-        string lastAction = undoStack->action;
-        Card* lastCard = undoStack->card;
+    void undoOne() {
+        Move last = undoStack->move;
+        MoveJournal::revert(state, last);
 
-        if (lastAction == "Stock to Waste") {
-            wasteCard = lastCard; // Return card to waste
-            cout << "Undid move: Stock to Waste, returned " << lastCard->toString() << " to waste.\n";
-        }
-        else if (lastAction == "Waste to Foundation") {
-            foundations.moveToFoundation(lastCard); // Simulate returning card to waste
-            wasteCard = lastCard;
-            cout << "Undid move: Waste to Foundation, returned " << lastCard->toString() << " to waste.\n";
-        }
-        else if (lastAction == "Waste to Tableau") {
-            tableau.pushCard(0, lastCard); // Return card to tableau (index 0 for simplicity)
-            cout << "Undid move: Waste to Tableau, returned " << lastCard->toString() << " to tableau.\n";
+        Card returned;
+        if (last.from == Move::StockPile) {
+            returned = Card(state.talon[state.wasteCount]);
         }
-        else if (lastAction == "Tableau to Foundation") {
-            tableau.pushCard(0, lastCard); // Return card to tableau (index 0 for simplicity)
-            cout << "Undid move: Tableau to Foundation, returned " << lastCard->toString() << " to tableau.\n";
+        else if (last.from == Move::WastePile) {
+            returned = Card(state.wasteTop());
         }
-        else if (lastAction == "Tableau to Tableau") {
-            tableau.pushCard(0, lastCard); // Return card to tableau (index 0 for simplicity)
-            cout << "Undid move: Tableau to Tableau, returned " << lastCard->toString() << " to tableau.\n";
+        else {
+            returned = Card(state.tableau[last.from][state.tableauCount[last.from] - last.count]);
         }
+        cout << "Undid move: " << Move::pileName(last.from) << " to " << Move::pileName(last.to)
+            << ", returned " << returned.toString() << " to " << Move::pileName(last.from) << ".\n";
 
         UndoLinkedlist* temp = undoStack;
         undoStack = undoStack->next;
-        delete temp;
+        undoPool.release(temp);
+    }
+
+    // Undo records go back to the pool for the next game
+    void clearUndo() {
+        while (undoStack) {
+            UndoLinkedlist* temp = undoStack;
+            undoStack = undoStack->next;
+            undoPool.release(temp);
+        }
     }
 
-    void addToUndoStack(const string& action, Card* card) {
-        UndoLinkedlist* newUndo = new UndoLinkedlist(action, card);
+    // Applies an already checked move and records it for undo
+    void perform(Move m) {
+        record(m, false);
+        if (autoFoundation) playSafeMoves(true);
+    }
+
+    void record(Move m, bool automatic) {
+        MoveJournal::apply(state, m);
+        UndoLinkedlist* newUndo = undoPool.acquire(m, automatic);
         newUndo->next = undoStack;
         undoStack = newUndo;
     }
 
-    void displayGameState() const {
-        cout << "\n--- Game State ---\n";
-        foundations.display();
-        tableau.display();
-        cout << "Waste: ";
-        if (wasteCard) {
-            cout << wasteCard->toString() << endl;
+    // Plays every foundation move AutoFoundation can prove safe. Attached
+    // moves are undone together with the command before them.
+    void playSafeMoves(bool attached) {
+        AutoFoundation safe(state);
+        Move m;
+        while (safe.next(state, m)) {
+            record(m, attached);
+            safe.played(state, m);
+            int suit = m.to - Move::FoundationPile;
+            cout << "Auto: " << Card(suit, state.foundation[suit]).toString() << " to Foundation\n";
         }
-        else {
-            cout << "Empty\n";
-        }
-        cout << "-------------------\n";
     }
 
-    void checkWinCondition() {
+    void displayGameState() {
+        renderer.draw(state);
+    }
+
+    // True once every card is on the foundations; play() then ends the session
+    bool checkWinCondition() {
         if (foundations.count() == 52) {
             cout << "Congratulations! You've won the game!\n";
-            exit(0); // End the game
+            return true;
         }
+        return false;
+    }
+
+    void showMemory() const {
+        cout << "Undo records in use: " << undoPool.getInUse()
+            << ", undo pool blocks taken from the heap: " << undoPool.getHeapAllocations() << "\n";
+        cout << "Board frames drawn: " << renderer.getFrames() << ", " << renderer.getBytes() << " bytes in "
+            << renderer.getWrites() << " writes\n";
+    }
+
+    void showStats() const {
+#ifdef SOLITAIRE_STATS
+        Instrumentation::global().report(cout);
+        showMemory();
+#else
+        cout << "Instrumentation is compiled out; rebuild with -DSOLITAIRE_STATS to enable it.\n";
+#endif
     }
 
 private:
     struct UndoLinkedlist {
-        string action;
-        Card* card;
+        Move move;
+        bool automatic; // played by auto-foundation, undone with the move before it
         UndoLinkedlist* next;
-        UndoLinkedlist(const string& act, Card* c) : action(act), card(c), next(nullptr) {}
+        UndoLinkedlist(Move m, bool a) : move(m), automatic(a), next(nullptr) {}
     };
 
+    GameState state;
     Deck deck;
     Tableau tableau;
     Foundation foundations;
-    Card* wasteCard;
+    NodePool<UndoLinkedlist> undoPool;
     UndoLinkedlist* undoStack;
+    HintEngine hints;
+    Renderer renderer;
+    uint64_t dealNumber;
+    GameState saved; // for load
+    uint64_t savedDeal; // the deal `saved` belongs to, which restart may have changed
+    bool hasSaved;
+    bool autoFoundation; // play safe foundation moves after every move command
 
 };
 
-int main() {
-    Solitaire solitaireGame;
+typedef BasicSolitaire<DrawOne> Solitaire;
+
+// Plain-text foundations and tableau, one pile per line, for output that
+// is read back rather than watched (the console draws through Renderer)
+void displayFoundations(const GameState& s) {
+    cout << "Foundation\n";
+    const char* suits[] = { "C", "H", "S", "D" }; // C: Clubs, H: Hearts, S: Spades, D: Diamonds
+    for (int i = 0; i < 4; ++i) {
+        cout << "\t" << suits[i];
+        if (s.foundation[i] != 0) {
+            cout << Card(i, s.foundation[i]).abbreviated();
+        }
+        else {
+            cout << " ";
+        }
+        cout << "\n";
+    }
+}
+
+void displayTableau(const GameState& s) {
+    cout << "Tableau\n";
+    for (int i = 0; i < 7; ++i) {
+        cout << "\t" << (i + 1);
+    }
+    cout << "\n";
+
+    for (int i = 0; i < 7; ++i) {
+        cout << "\t";
+        for (int j = s.tableauCount[i] - 1; j >= 0; --j) {
+            Card card(s.tableau[i][j]);
+            if (card.isFaceUp()) {
+                cout << card.abbreviated();
+            }
+            else {
+                cout << "x"; // Indicate face-down cards
+            }
+            cout << "\t";
+        }
+        cout << "\n";
+    }
+}
+
+// Replays a command script without prompts or a redraw per command. The
+// whole input is read in one block and parsed in place; errors are kept
+// with their line numbers and reported after a single final summary.
+// Besides the console commands a script may use `deal K` to start a fresh
+// game, `show` to print the board at that point and `#` for comments.
+// `mv` draws and turns the waste over as the rule set says.
+template <typename Rules>
+class BasicScriptRunner {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef BasicSolver<Rules> Solver;
+
+    static const int MaxReportedErrors = 1000;
+
+    BasicScriptRunner(uint64_t dealNumber) : history(new Move[1024]), historyCapacity(1024), historySize(0),
+        commands(0), errorCount(0), sessions(1), wins(0), won(false) {
+        newDeal(state, dealNumber);
+    }
+
+    ~BasicScriptRunner() {
+        delete[] history;
+    }
+
+    BasicScriptRunner(const BasicScriptRunner&) = delete;
+    BasicScriptRunner& operator=(const BasicScriptRunner&) = delete;
+
+    // `path` of "-" reads stdin. Returns the process exit code.
+    int run(const char* path) {
+        string input;
+        if (!readAll(path, input)) {
+            cout << "Cannot read script " << path << "\n";
+            return 1;
+        }
+
+        auto begin = chrono::steady_clock::now();
+        const char* p = input.data();
+        const char* end = p + input.size();
+        int line = 0;
+        while (p < end) {
+            const char* eol = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+            if (!eol) eol = end;
+            ++line;
+            if (!execute(p, eol, line)) break;
+            p = eol + 1;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        cout << "--- Script summary ---\n";
+        cout << "Lines: " << line << ", commands: " << commands << ", errors: " << errorCount
+            << ", games: " << sessions << ", won: " << wins << "\n";
+        cout << "Elapsed: " << seconds * 1000 << " ms (" << uint64_t(commands / max(seconds, 1e-9)) << " commands/s)\n";
+        show();
+        if (errorCount) {
+            cout << "Errors:\n" << errors;
+            if (errorCount > MaxReportedErrors) {
+                cout << "\t... " << (errorCount - MaxReportedErrors) << " more\n";
+            }
+        }
+        return errorCount ? 1 : 0;
+    }
+
+private:
+    static bool readAll(const char* path, string& out) {
+        bool useStdin = strcmp(path, "-") == 0;
+        FILE* f = useStdin ? stdin : fopen(path, "rb");
+        if (!f) return false;
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+            out.append(chunk, n);
+        }
+        if (!useStdin) fclose(f);
+        return true;
+    }
+
+    static const char* skipSpaces(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        return p;
+    }
+
+    // Reads a decimal number; false if there is none
+    static bool number(const char*& p, const char* end, uint64_t& value) {
+        p = skipSpaces(p, end);
+        if (p == end || *p < '0' || *p > '9') return false;
+        value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + uint64_t(*p++ - '0');
+        return true;
+    }
+
+    // False when the script asked to stop
+    bool execute(const char* p, const char* end, int line) {
+        p = skipSpaces(p, end);
+        if (p == end || *p == '#') return true;
+        const char* word = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+        string command(word, size_t(p - word));
+        ++commands;
+
+        uint64_t a, b;
+        Move m;
+        if (command == "mv") {
+            if (!MoveGenerator::stockMove(state, m)) return fail(line, "no cards left in the stock");
+            perform(m, line);
+        }
+        else if (command == "wf") {
+            if (state.wasteCount == 0) return fail(line, "no card in waste");
+            uint8_t card = state.wasteTop();
+            perform(Move{ Move::WastePile, uint8_t(Move::FoundationPile + (card & 3)), 1, 0 }, line);
+        }
+        else if (command == "wt") {
+            if (!number(p, end, a) || a < 1 || a > 7) return fail(line, "invalid tableau index");
+            if (state.wasteCount == 0) return fail(line, "no card in waste");
+            perform(Move{ Move::WastePile, uint8_t(a - 1), 1, 0 }, line);
+        }
+        else if (command == "mt") {
+            if (!number(p, end, a) || a < 1 || a > 7) return fail(line, "invalid tableau index");
+            if (state.tableauCount[a - 1] == 0) return fail(line, "no card to move from tableau");
+            if (number(p, end, b)) {
+                if (b < 1 || b > 7) return fail(line, "invalid tableau index");
+                moveBetweenTableaus(int(a - 1), int(b - 1), line);
+            }
+            else {
+                uint8_t card = state.tableau[a - 1][state.tableauCount[a - 1] - 1];
+                perform(Move{ uint8_t(a - 1), uint8_t(Move::FoundationPile + (card & 3)), 1, 0 }, line);
+            }
+        }
+        else if (command == "undo") {
+            if (historySize == 0) return fail(line, "no moves to undo");
+            MoveJournal::revert(state, history[--historySize]);
+        }
+        else if (command == "deal") {
+            if (!number(p, end, a)) return fail(line, "missing deal number");
+            newDeal(state, a);
+            historySize = 0;
+            won = false;
+            ++sessions;
+        }
+        else if (command == "show") {
+            show();
+        }
+        else if (command == "exit") {
+            return false;
+        }
+        else {
+            return fail(line, "invalid command '" + command + "'");
+        }
+        return true;
+    }
+
+    void perform(Move m, int line) {
+        if (!MoveGenerator::isLegal(state, m)) {
+            fail(line, "illegal move");
+            return;
+        }
+        MoveJournal::apply(state, m);
+        if (historySize == historyCapacity) {
+            Move* grown = new Move[historyCapacity * 2];
+            memcpy(grown, history, sizeof(Move) * historySize);
+            delete[] history;
+            history = grown;
+            historyCapacity *= 2;
+        }
+        history[historySize++] = m;
+        if (!won && Solver::isWon(state)) {
+            won = true;
+            ++wins;
+        }
+    }
+
+    void moveBetweenTableaus(int from, int to, int line) {
+        Move moves[MoveGenerator::MaxMoves];
+        int n = MoveGenerator::generateMoves(state, moves);
+        for (int i = 0; i < n; ++i) {
+            if (moves[i].from == from && moves[i].to == to) {
+                perform(moves[i], line);
+                return;
+            }
+        }
+        fail(line, "illegal move");
+    }
+
+    bool fail(int line, const string& message) {
+        if (++errorCount <= MaxReportedErrors) {
+            errors += "\tline " + to_string(line) + ": " + message + "\n";
+        }
+        return true;
+    }
+
+    void show() {
+        cout << "\n--- Game State ---\n";
+        displayFoundations(state);
+        displayTableau(state);
+        cout << "Waste: ";
+        if (state.wasteCount) {
+            cout << Card(state.wasteTop()).toString() << "\n";
+        }
+        else {
+            cout << "Empty\n";
+        }
+        cout << "Stock: " << state.stockCount() << " cards\n";
+        cout << "-------------------\n";
+    }
+
+    GameState state;
+    Move* history;
+    int historyCapacity;
+    int historySize;
+    uint64_t commands;
+    uint64_t errorCount;
+    uint64_t sessions;
+    uint64_t wins;
+    bool won;
+    string errors;
+};
+
+typedef BasicScriptRunner<DrawOne> ScriptRunner;
+
+// Hosts many independent games over a line-based socket protocol. Each
+// shard thread runs its own epoll loop over the shared listening socket
+// (EPOLLEXCLUSIVE, so a connection wakes one shard) and owns the sessions it
+// accepted, taken from a per-shard NodePool. Nothing is shared between
+// shards and a command never blocks: replies go to a fixed per-session
+// buffer and a client that stops reading stops being read.
+//
+// Protocol: one command per line, the console set (mv, wf, wt T, mt T,
+// mt T1 T2, undo) plus `show`, `hint [ms]`, `deal K` and `exit`. A reply is any number of
+// board lines followed by a status line starting with "ok" or "err".
+// Every session plays under the server's rule set.
+template <typename Rules>
+class BasicGameServer {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef BasicSolver<Rules> Solver;
+    typedef BasicHintEngine<Rules> HintEngine;
+
+    static const int InputSize = 512;
+    static const int OutputSize = 4096;
+    static const int MaxReply = 1024;   // no single reply is longer
+    static constexpr int HistorySize = 256; // undo depth per session
+    static const int MaxEvents = 256;
+    static const int DefaultHintMillis = 5;
+    static const int MaxHintMillis = 50; // a hint stalls the whole shard for this long
+
+    struct Options {
+        string address = "7777"; // PORT, HOST:PORT, or a Unix socket path (anything with a '/')
+        int threads = 1;
+    };
+
+    BasicGameServer(const Options& o) : options(o), listenFd(-1) {
+        if (options.threads <= 0) {
+            options.threads = max(1, int(thread::hardware_concurrency()));
+        }
+    }
+
+    ~BasicGameServer() {
+        if (listenFd >= 0) ::close(listenFd);
+    }
+
+    BasicGameServer(const BasicGameServer&) = delete;
+    BasicGameServer& operator=(const BasicGameServer&) = delete;
+
+    // Serves until the process is stopped; returns only on a setup error
+    int run() {
+        signal(SIGPIPE, SIG_IGN);
+        if (!listen()) return 1;
+        cout << "Serving on " << options.address << " with " << options.threads << " shard(s)" << endl;
+
+        thread* threads = new thread[options.threads];
+        for (int i = 0; i < options.threads; ++i) {
+            threads[i] = thread([this, i]() { serve(i); });
+        }
+        for (int i = 0; i < options.threads; ++i) {
+            threads[i].join();
+        }
+        delete[] threads;
+        return 0;
+    }
+
+private:
+    struct Session {
+        int fd;
+        HintEngine* hints; // the owning shard's
+        bool closing;
+        bool won;
+        uint64_t dealNumber;
+        GameState state;
+        Move history[HistorySize]; // ring: the last HistorySize moves
+        int historyCount;
+        int historyDepth;
+        int inLength;
+        int outStart;
+        int outLength;
+        char in[InputSize];
+        char out[OutputSize];
+
+        Session(int socket, HintEngine* engine, uint64_t deal) : fd(socket), hints(engine), closing(false), won(false), dealNumber(deal),
+            historyCount(0), historyDepth(0), inLength(0), outStart(0), outLength(0) {
+            newDeal(state, deal);
+        }
+    };
+
+    struct Shard {
+        int epoll;
+        NodePool<Session, 64> pool;
+        mt19937_64 deals;
+        HintEngine hints;
+    };
+
+    bool listen() {
+        const string& address = options.address;
+        if (address.find('/') != string::npos) {
+            sockaddr_un un;
+            memset(&un, 0, sizeof(un));
+            un.sun_family = AF_UNIX;
+            if (address.size() >= sizeof(un.sun_path)) {
+                cout << "Socket path too long: " << address << "\n";
+                return false;
+            }
+            memcpy(un.sun_path, address.c_str(), address.size());
+            unlink(address.c_str());
+            listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&un), sizeof(un)) != 0) {
+                cout << "Cannot bind " << address << ": " << strerror(errno) << "\n";
+                return false;
+            }
+        }
+        else {
+            size_t colon = address.rfind(':');
+            string host = colon == string::npos ? "127.0.0.1" : address.substr(0, colon);
+            int port = atoi(address.c_str() + (colon == string::npos ? 0 : colon + 1));
+            sockaddr_in in;
+            memset(&in, 0, sizeof(in));
+            in.sin_family = AF_INET;
+            in.sin_port = htons(uint16_t(port));
+            if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &in.sin_addr) != 1) {
+                cout << "Invalid address " << address << "\n";
+                return false;
+            }
+            listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            int yes = 1;
+            if (listenFd >= 0) setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&in), sizeof(in)) != 0) {
+                cout << "Cannot bind " << address << ": " << strerror(errno) << "\n";
+                return false;
+            }
+        }
+        if (::listen(listenFd, SOMAXCONN) != 0) {
+            cout << "Cannot listen on " << address << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    void serve(int index) {
+        Shard* shard = new Shard;
+        shard->epoll = epoll_create1(EPOLL_CLOEXEC);
+        shard->deals.seed((uint64_t(random_device()()) << 32) ^ random_device()() ^ uint64_t(index));
+
+        epoll_event listening;
+        listening.events = EPOLLIN | EPOLLEXCLUSIVE;
+        listening.data.ptr = nullptr;
+        epoll_ctl(shard->epoll, EPOLL_CTL_ADD, listenFd, &listening);
+
+        epoll_event events[MaxEvents];
+        while (true) {
+            int n = epoll_wait(shard->epoll, events, MaxEvents, -1);
+            for (int i = 0; i < n; ++i) {
+                Session* session = static_cast<Session*>(events[i].data.ptr);
+                if (!session) {
+                    accept(*shard);
+                    continue;
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    session->closing = true;
+                    session->outLength = 0;
+                }
+                if (!session->closing && (events[i].events & (EPOLLIN | EPOLLRDHUP))) {
+                    receive(*session);
+                }
+                flush(*shard, *session);
+            }
+        }
+    }
+
+    void accept(Shard& shard) {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return; // EAGAIN, or another shard got there first
+            int yes = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes)); // harmless failure on Unix sockets
+
+            Session* session = shard.pool.acquire(fd, &shard.hints, shard.deals());
+            epoll_event event;
+            event.events = EPOLLIN | EPOLLRDHUP;
+            event.data.ptr = session;
+            epoll_ctl(shard.epoll, EPOLL_CTL_ADD, fd, &event);
+
+            reply(*session, "ok deal %llu\n", (unsigned long long)session->dealNumber);
+            flush(shard, *session);
+        }
+    }
+
+    // Reads what is available and runs every complete line while the reply buffer has room
+    void receive(Session& session) {
+        while (!session.closing) {
+            if (session.inLength < InputSize) {
+                ssize_t n = recv(session.fd, session.in + session.inLength, size_t(InputSize - session.inLength), 0);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    session.closing = true;
+                    return;
+                }
+                if (n > 0) session.inLength += int(n);
+            }
+            int consumed = executeLines(session);
+            if (consumed == 0) {
+                if (session.inLength == InputSize) {
+                    reply(session, "err line too long\n");
+                    session.closing = true;
+                }
+                return;
+            }
+            memmove(session.in, session.in + consumed, size_t(session.inLength - consumed));
+            session.inLength -= consumed;
+            if (OutputSize - session.outStart - session.outLength < MaxReply) return; // wait for the client to read
+        }
+    }
+
+    int executeLines(Session& session) {
+        int consumed = 0;
+        while (!session.closing && OutputSize - session.outStart - session.outLength >= MaxReply) {
+            const char* begin = session.in + consumed;
+            const char* eol = static_cast<const char*>(memchr(begin, '\n', size_t(session.inLength - consumed)));
+            if (!eol) break;
+            execute(session, begin, eol);
+            consumed = int(eol - session.in) + 1;
+        }
+        return consumed;
+    }
+
+    // Writes as much pending output as the socket takes and picks the events to wait for
+    void flush(Shard& shard, Session& session) {
+        while (session.outLength > 0) {
+            ssize_t n = send(session.fd, session.out + session.outStart, size_t(session.outLength), MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                if (errno == EINTR) continue;
+                session.closing = true;
+                session.outLength = 0;
+                break;
+            }
+            session.outStart += int(n);
+            session.outLength -= int(n);
+        }
+        if (session.outLength == 0) session.outStart = 0;
+
+        if (session.closing && session.outLength == 0) {
+            ::close(session.fd); // also removes it from the epoll set
+            shard.pool.release(&session);
+            return;
+        }
+        if (session.outLength == 0 && !session.closing && session.inLength > 0) {
+            // Lines held back while the buffer was full can run now
+            int consumed = executeLines(session);
+            if (consumed > 0) {
+                memmove(session.in, session.in + consumed, size_t(session.inLength - consumed));
+                session.inLength -= consumed;
+                flush(shard, session);
+                return;
+            }
+        }
+
+        epoll_event event;
+        event.events = session.outLength > 0 ? uint32_t(EPOLLOUT) : uint32_t(EPOLLIN | EPOLLRDHUP);
+        event.data.ptr = &session;
+        epoll_ctl(shard.epoll, EPOLL_CTL_MOD, session.fd, &event);
+    }
+
+    static void reply(Session& session, const char* format, ...) {
+        char* at = session.out + session.outStart + session.outLength;
+        int room = OutputSize - session.outStart - session.outLength;
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(at, size_t(room), format, args);
+        va_end(args);
+        session.outLength += min(max(n, 0), room - 1);
+    }
+
+    static const char* skipSpaces(const char* p, const char* end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+        return p;
+    }
+
+    static bool number(const char*& p, const char* end, uint64_t& value) {
+        p = skipSpaces(p, end);
+        if (p == end || *p < '0' || *p > '9') return false;
+        value = 0;
+        while (p < end && *p >= '0' && *p <= '9') value = value * 10 + uint64_t(*p++ - '0');
+        return true;
+    }
+
+    void execute(Session& session, const char* p, const char* end) {
+        GameState& s = session.state;
+        p = skipSpaces(p, end);
+        const char* word = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+        size_t length = size_t(p - word);
+        auto is = [&](const char* command) { return strlen(command) == length && memcmp(word, command, length) == 0; };
+
+        uint64_t a, b;
+        Move m;
+        if (length == 0) {
+            reply(session, "err empty command\n");
+        }
+        else if (is("mv")) {
+            if (!MoveGenerator::stockMove(s, m)) reply(session, "err no cards left in the stock\n");
+            else perform(session, m);
+        }
+        else if (is("wf")) {
+            if (s.wasteCount == 0) reply(session, "err no card in waste\n");
+            else perform(session, Move{ Move::WastePile, uint8_t(Move::FoundationPile + (s.wasteTop() & 3)), 1, 0 });
+        }
+        else if (is("wt")) {
+            if (!number(p, end, a) || a < 1 || a > 7) reply(session, "err invalid tableau index\n");
+            else if (s.wasteCount == 0) reply(session, "err no card in waste\n");
+            else perform(session, Move{ Move::WastePile, uint8_t(a - 1), 1, 0 });
+        }
+        else if (is("mt")) {
+            if (!number(p, end, a) || a < 1 || a > 7) reply(session, "err invalid tableau index\n");
+            else if (s.tableauCount[a - 1] == 0) reply(session, "err no card to move from tableau\n");
+            else if (number(p, end, b)) {
+                if (b < 1 || b > 7) reply(session, "err invalid tableau index\n");
+                else moveBetweenTableaus(session, int(a - 1), int(b - 1));
+            }
+            else {
+                uint8_t card = s.tableau[a - 1][s.tableauCount[a - 1] - 1];
+                perform(session, Move{ uint8_t(a - 1), uint8_t(Move::FoundationPile + (card & 3)), 1, 0 });
+            }
+        }
+        else if (is("undo")) {
+            if (session.historyDepth == 0) {
+                reply(session, "err no moves to undo\n");
+            }
+            else {
+                --session.historyCount;
+                --session.historyDepth;
+                MoveJournal::revert(s, session.history[session.historyCount % HistorySize]);
+                reply(session, "ok\n");
+            }
+        }
+        else if (is("deal")) {
+            if (!number(p, end, a)) {
+                reply(session, "err missing deal number\n");
+            }
+            else {
+                newDeal(s, a);
+                session.dealNumber = a;
+                session.historyCount = session.historyDepth = 0;
+                session.won = false;
+                reply(session, "ok deal %llu\n", (unsigned long long)a);
+            }
+        }
+        else if (is("show")) {
+            show(session);
+        }
+        else if (is("hint")) {
+            if (!number(p, end, a)) a = DefaultHintMillis;
+            typename HintEngine::Hint result;
+            session.hints->hint(s, chrono::milliseconds(min<uint64_t>(a, MaxHintMillis)), result);
+            if (result.found) reply(session, "ok %s\n", result.move.toCommand().c_str());
+            else reply(session, "err no moves left\n");
+        }
+        else if (is("exit")) {
+            reply(session, "ok bye\n");
+            session.closing = true;
+        }
+        else {
+            reply(session, "err invalid command\n");
+        }
+    }
+
+    void perform(Session& session, Move m) {
+        if (!MoveGenerator::isLegal(session.state, m)) {
+            reply(session, "err illegal move\n");
+            return;
+        }
+        MoveJournal::apply(session.state, m);
+        session.history[session.historyCount++ % HistorySize] = m;
+        session.historyDepth = min(session.historyDepth + 1, HistorySize);
+        if (!session.won && Solver::isWon(session.state)) {
+            session.won = true;
+            reply(session, "ok won\n");
+        }
+        else {
+            reply(session, "ok\n");
+        }
+    }
+
+    void moveBetweenTableaus(Session& session, int from, int to) {
+        Move moves[MoveGenerator::MaxMoves];
+        int n = MoveGenerator::generateMoves(session.state, moves);
+        for (int i = 0; i < n; ++i) {
+            if (moves[i].from == from && moves[i].to == to) {
+                perform(session, moves[i]);
+                return;
+            }
+        }
+        reply(session, "err illegal move\n");
+    }
+
+    // The board as the console draws it, one line per foundation and column
+    static void show(Session& session) {
+        const GameState& s = session.state;
+        const char* suits = "HDCS";
+        for (int suit = 0; suit < 4; ++suit) {
+            int height = s.foundation[suit];
+            reply(session, "%c %s\n", suits[suit], height ? Card(uint8_t((height << 2) | suit)).abbreviated().c_str() : "-");
+        }
+        for (int i = 0; i < 7; ++i) {
+            char line[19 * 4 + 8];
+            int n = snprintf(line, sizeof(line), "%d", i + 1);
+            for (int j = 0; j < s.tableauCount[i]; ++j) {
+                Card card(s.tableau[i][j]);
+                n += snprintf(line + n, sizeof(line) - size_t(n), " %s", card.isFaceUp() ? card.abbreviated().c_str() : "x");
+            }
+            reply(session, "%s\n", line);
+        }
+        reply(session, "W %s\nS %d\nok\n", s.wasteCount ? Card(s.wasteTop()).abbreviated().c_str() : "-", s.stockCount());
+    }
+
+    Options options;
+    int listenFd;
+};
+
+typedef BasicGameServer<DrawOne> GameServer;
+
+// Binary game records. A file is a header, the records back to back, then a
+// sparse index and a trailer written when the writer is closed:
+//   record:  Entry (deal, micros, move count, outcome) + uint16 move[count], padded to 8 bytes
+//   index:   uint64 file offset of every IndexStride-th record
+//   trailer: record count, index offset, magic
+// A move packs as from:4 | to:4 | count:5. Fields are stored in host byte
+// order (little-endian on every machine we run on).
+struct GameRecord {
+    static const uint64_t Magic = 0x31304345524C4F53ull;        // "SOLREC01"
+    static const uint64_t TrailerMagic = 0x444E45434552534Full; // "OSRECEND"
+    static const uint32_t Version = 1;
+    static const int IndexStride = 256;
+
+    enum Outcome { Lost = 0, Won = 1, Unknown = 2 };
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t unused[2];
+    };
+
+    struct Entry {
+        uint64_t dealNumber;
+        uint32_t micros;
+        uint16_t moveCount;
+        uint8_t outcome;
+        uint8_t unused;
+    };
+
+    struct Trailer {
+        uint64_t count;
+        uint64_t indexOffset;
+        uint64_t magic;
+    };
+
+    static size_t size(int moveCount) {
+        return (sizeof(Entry) + 2 * size_t(moveCount) + 7) & ~size_t(7);
+    }
+
+    static uint16_t pack(const Move& m) {
+        return uint16_t(m.from | (m.to << 4) | (m.count << 8));
+    }
+
+    static Move unpack(uint16_t packed) {
+        return Move{ uint8_t(packed & 0xF), uint8_t((packed >> 4) & 0xF), uint8_t(packed >> 8), 0 };
+    }
+};
+
+static_assert(sizeof(GameRecord::Header) == 32 && sizeof(GameRecord::Entry) == 16, "record layout is part of the file format");
+
+// Appends records from many threads. Each producer fills its own Buffer with
+// no synchronisation at all; only a full buffer is handed to a background
+// thread that writes it out and hands it back, so workers never wait on the
+// disk unless every spare buffer is queued.
+class RecordWriter {
+public:
+    static const size_t BufferSize = 1 << 18;
+    static const int SpareBuffers = 8;
+
+    struct Buffer {
+        char data[BufferSize];
+        size_t used;
+        Buffer* next;
+    };
+
+    RecordWriter(const char* path) : file(fopen(path, "wb")), queue(nullptr), queueTail(nullptr), spare(nullptr),
+        closing(false), offset(sizeof(GameRecord::Header)), count(0), index(nullptr), indexSize(0), indexCapacity(0) {
+        if (!file) return;
+        GameRecord::Header header = { GameRecord::Magic, GameRecord::Version, 0, { 0, 0 } };
+        fwrite(&header, sizeof(header), 1, file);
+        for (int i = 0; i < SpareBuffers; ++i) {
+            release(new Buffer);
+        }
+        writer = thread([this]() { drain(); });
+    }
+
+    ~RecordWriter() {
+        close();
+    }
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    // A free buffer for a producer; blocks only when all of them are queued
+    Buffer* acquire() {
+        unique_lock<mutex> lock(lockGuard);
+        wake.wait(lock, [this]() { return spare != nullptr; });
+        Buffer* buffer = spare;
+        spare = buffer->next;
+        buffer->used = 0;
+        return buffer;
+    }
+
+    // Queues a filled buffer for writing; the producer must not touch it again
+    void submit(Buffer* buffer) {
+        buffer->next = nullptr;
+        lock_guard<mutex> lock(lockGuard);
+        if (queueTail) queueTail->next = buffer;
+        else queue = buffer;
+        queueTail = buffer;
+        wake.notify_all();
+    }
+
+    // Adds one record to a producer's buffer, swapping it out when full
+    void append(Buffer*& buffer, uint64_t dealNumber, uint32_t micros, GameRecord::Outcome outcome, const Move* moves, int moveCount) {
+        size_t bytes = GameRecord::size(moveCount);
+        if (buffer->used + bytes > BufferSize) {
+            submit(buffer);
+            buffer = acquire();
+        }
+        char* at = buffer->data + buffer->used;
+        GameRecord::Entry entry = { dealNumber, micros, uint16_t(moveCount), uint8_t(outcome), 0 };
+        memcpy(at, &entry, sizeof(entry));
+        uint16_t* packed = reinterpret_cast<uint16_t*>(at + sizeof(entry));
+        for (int i = 0; i < moveCount; ++i) {
+            packed[i] = GameRecord::pack(moves[i]);
+        }
+        memset(at + sizeof(entry) + 2 * size_t(moveCount), 0, bytes - sizeof(entry) - 2 * size_t(moveCount));
+        buffer->used += bytes;
+    }
+
+    // Flushes everything queued and writes the index and trailer
+    void close() {
+        if (!file) return;
+        {
+            lock_guard<mutex> lock(lockGuard);
+            closing = true;
+            wake.notify_all();
+        }
+        writer.join();
+
+        GameRecord::Trailer trailer = { count, offset, GameRecord::TrailerMagic };
+        fwrite(index, sizeof(uint64_t), indexSize, file);
+        fwrite(&trailer, sizeof(trailer), 1, file);
+        fclose(file);
+        file = nullptr;
+
+        while (spare) {
+            Buffer* next = spare->next;
+            delete spare;
+            spare = next;
+        }
+        delete[] index;
+    }
+
+private:
+    void release(Buffer* buffer) {
+        lock_guard<mutex> lock(lockGuard);
+        buffer->next = spare;
+        spare = buffer;
+        wake.notify_all();
+    }
+
+    void drain() {
+        while (true) {
+            Buffer* buffer;
+            {
+                unique_lock<mutex> lock(lockGuard);
+                wake.wait(lock, [this]() { return queue != nullptr || closing; });
+                if (!queue) return;
+                buffer = queue;
+                queue = buffer->next;
+                if (!queue) queueTail = nullptr;
+            }
+            indexBuffer(*buffer);
+            fwrite(buffer->data, 1, buffer->used, file);
+            offset += buffer->used;
+            release(buffer);
+        }
+    }
+
+    // Notes the offset of every IndexStride-th record in the buffer
+    void indexBuffer(const Buffer& buffer) {
+        size_t at = 0;
+        while (at < buffer.used) {
+            if (count % GameRecord::IndexStride == 0) {
+                if (indexSize == indexCapacity) {
+                    indexCapacity = indexCapacity ? indexCapacity * 2 : 1024;
+                    uint64_t* grown = new uint64_t[indexCapacity];
+                    if (indexSize) memcpy(grown, index, indexSize * sizeof(uint64_t));
+                    delete[] index;
+                    index = grown;
+                }
+                index[indexSize++] = offset + at;
+            }
+            GameRecord::Entry entry;
+            memcpy(&entry, buffer.data + at, sizeof(entry));
+            at += GameRecord::size(entry.moveCount);
+            ++count;
+        }
+    }
+
+    FILE* file;
+    thread writer;
+    mutex lockGuard;
+    condition_variable wake;
+    Buffer* queue;
+    Buffer* queueTail;
+    Buffer* spare;
+    bool closing;
+    uint64_t offset;
+    uint64_t count;
+    uint64_t* index;
+    size_t indexSize;
+    size_t indexCapacity;
+};
+
+// Maps a record file read-only and walks it in place. Files that were not
+// closed cleanly have no trailer, and a trailer whose sizes or offsets do
+// not fit the file is not trusted; in both cases the index is rebuilt by
+// one scan.
+class RecordReader {
+public:
+    struct View {
+        uint64_t dealNumber;
+        uint32_t micros;
+        GameRecord::Outcome outcome;
+        int moveCount;
+        const uint16_t* moves;
+
+        Move move(int i) const {
+            return GameRecord::unpack(moves[i]);
+        }
+    };
+
+    RecordReader(const char* path) : base(nullptr), length(0), end(0), count(0), index(nullptr), ownedIndex(nullptr) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(GameRecord::Header)) {
+            length = size_t(info.st_size);
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            base = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+        if (!base) return;
+
+        const GameRecord::Header* header = reinterpret_cast<const GameRecord::Header*>(base);
+        if (header->magic != GameRecord::Magic || header->version != GameRecord::Version) {
+            unmap();
+            return;
+        }
+        madvise(const_cast<char*>(base), length, MADV_SEQUENTIAL);
+
+        const GameRecord::Trailer* trailer = length >= sizeof(GameRecord::Header) + sizeof(GameRecord::Trailer)
+            ? reinterpret_cast<const GameRecord::Trailer*>(base + length - sizeof(GameRecord::Trailer)) : nullptr;
+        if (trailer && trailer->magic == GameRecord::TrailerMagic && fits(*trailer)) {
+            count = trailer->count;
+            end = trailer->indexOffset;
+            index = reinterpret_cast<const uint64_t*>(base + end);
+        }
+        else {
+            rebuildIndex();
+        }
+    }
+
+    ~RecordReader() {
+        unmap();
+    }
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    bool isOpen() const { return base != nullptr; }
+    uint64_t size() const { return count; }
+
+    // Random access: jump through the sparse index, then skip at most IndexStride - 1 records
+    bool get(uint64_t i, View& view) const {
+        if (i >= count) return false;
+        size_t at = size_t(index[i / GameRecord::IndexStride]);
+        for (uint64_t k = i - i % GameRecord::IndexStride; k < i && holds(at); ++k) {
+            at += GameRecord::size(entryAt(at)->moveCount);
+        }
+        if (!holds(at)) return false;
+        fill(at, view);
+        return true;
+    }
+
+    // Calls f(const View&) for every record in file order; stops at a record that runs past the data
+    template <typename F>
+    void forEach(F f) const {
+        View view;
+        size_t at = sizeof(GameRecord::Header);
+        for (uint64_t i = 0; i < count && holds(at); ++i) {
+            fill(at, view);
+            f(view);
+            at += GameRecord::size(view.moveCount);
+        }
+    }
+
+private:
+    // True when the trailer's count, index and offsets all lie inside the file
+    bool fits(const GameRecord::Trailer& trailer) const {
+        size_t records = sizeof(GameRecord::Header);
+        if (trailer.indexOffset < records || trailer.indexOffset > length - sizeof(GameRecord::Trailer) || trailer.indexOffset % 8) {
+            return false;
+        }
+        if (trailer.count > (trailer.indexOffset - records) / sizeof(GameRecord::Entry)) return false;
+        uint64_t slots = (trailer.count + GameRecord::IndexStride - 1) / GameRecord::IndexStride;
+        if (trailer.indexOffset + slots * sizeof(uint64_t) + sizeof(GameRecord::Trailer) != length) return false;
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + trailer.indexOffset);
+        for (uint64_t i = 0; i < slots; ++i) {
+            if (offsets[i] < records || offsets[i] >= trailer.indexOffset || offsets[i] % 8) return false;
+        }
+        return true;
+    }
+
+    // True when a whole record starts at `at`, before the index
+    bool holds(size_t at) const {
+        return at + sizeof(GameRecord::Entry) <= end && at + GameRecord::size(entryAt(at)->moveCount) <= end;
+    }
+
+    const GameRecord::Entry* entryAt(size_t at) const {
+        return reinterpret_cast<const GameRecord::Entry*>(base + at);
+    }
+
+    void fill(size_t at, View& view) const {
+        const GameRecord::Entry* entry = entryAt(at);
+        view.dealNumber = entry->dealNumber;
+        view.micros = entry->micros;
+        view.outcome = GameRecord::Outcome(entry->outcome);
+        view.moveCount = entry->moveCount;
+        view.moves = reinterpret_cast<const uint16_t*>(base + at + sizeof(GameRecord::Entry));
+    }
+
+    void rebuildIndex() {
+        end = sizeof(GameRecord::Header);
+        count = 0;
+        size_t capacity = 1024;
+        ownedIndex = new uint64_t[capacity];
+        while (end + sizeof(GameRecord::Entry) <= length) {
+            size_t bytes = GameRecord::size(entryAt(end)->moveCount);
+            if (end + bytes > length) break; // torn final record
+            if (count % GameRecord::IndexStride == 0) {
+                size_t slot = size_t(count / GameRecord::IndexStride);
+                if (slot == capacity) {
+                    uint64_t* grown = new uint64_t[capacity * 2];
+                    memcpy(grown, ownedIndex, capacity * sizeof(uint64_t));
+                    delete[] ownedIndex;
+                    ownedIndex = grown;
+                    capacity *= 2;
+                }
+                ownedIndex[slot] = end;
+            }
+            end += bytes;
+            ++count;
+        }
+        index = ownedIndex;
+    }
+
+    void unmap() {
+        if (base) munmap(const_cast<char*>(base), length);
+        base = nullptr;
+        delete[] ownedIndex;
+        ownedIndex = nullptr;
+    }
+
+    const char* base;
+    size_t length;
+    size_t end;
+    uint64_t count;
+    const uint64_t* index;
+    uint64_t* ownedIndex;
+};
+
+// --records: summarise a record file, or print one game's moves
+int showRecords(const char* path, bool single, uint64_t game) {
+    auto begin = chrono::steady_clock::now();
+    RecordReader reader(path);
+    if (!reader.isOpen()) {
+        cout << "Cannot read " << path << "\n";
+        return 1;
+    }
+    const char* outcomes[] = { "lost", "won", "unknown" };
+
+    if (single) {
+        RecordReader::View view;
+        if (!reader.get(game, view)) {
+            cout << "No game " << game << " (file holds " << reader.size() << ")\n";
+            return 1;
+        }
+        cout << "Game " << game << ": deal " << view.dealNumber << ", " << outcomes[view.outcome] << " in "
+            << view.moveCount << " moves, " << view.micros << " us\n";
+        for (int i = 0; i < view.moveCount; ++i) {
+            cout << "\t" << (i + 1) << ". " << view.move(i).toCommand() << "\n";
+        }
+        return 0;
+    }
+
+    uint64_t games = 0, wins = 0, moves = 0, micros = 0;
+    reader.forEach([&](const RecordReader::View& view) {
+        games++;
+        wins += view.outcome == GameRecord::Won;
+        moves += view.moveCount;
+        micros += view.micros;
+    });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    uint64_t shown = max<uint64_t>(games, 1);
+    cout << "Games: " << games << ", wins: " << wins << " (" << 100.0 * wins / shown << "%)\n";
+    cout << "Average moves per game: " << double(moves) / shown << ", average time " << double(micros) / shown << " us\n";
+    cout << "Scanned in " << seconds << " s: " << uint64_t(games / max(seconds, 1e-9)) << " games/s\n";
+    return 0;
+}
+
+// Lane-wise operations on 8-bit card codes, one game per lane. SimdLanes
+// is AVX2 or SSE2, whichever the build targets, and ScalarLanes is the
+// plain fallback; the batch engine is written once against this interface.
+// Masks are 0xFF for true and 0 for false in every lane.
+struct ScalarLanes {
+    typedef uint8_t V;
+    static const int Width = 1;
+
+    static V load(const uint8_t* p) { return *p; }
+    static void store(uint8_t* p, V v) { *p = v; }
+    static V splat(uint8_t x) { return x; }
+    static V eq(V a, V b) { return a == b ? 0xFF : 0; }
+    static V both(V a, V b) { return a & b; }
+    static V either(V a, V b) { return a | b; }
+    static V differ(V a, V b) { return a ^ b; }
+    static V add(V a, V b) { return uint8_t(a + b); }
+    static V rank(V v) { return (v >> 2) & 0xF; }
+    static V select(V mask, V a, V b) { return (mask & a) | (~mask & b); }
+    static bool any(V mask) { return mask != 0; }
+};
+
+#if defined(__AVX2__)
+struct SimdLanes {
+    typedef __m256i V;
+    static const int Width = 32;
+
+    static V load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(uint8_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static V splat(uint8_t x) { return _mm256_set1_epi8(char(x)); }
+    static V eq(V a, V b) { return _mm256_cmpeq_epi8(a, b); }
+    static V both(V a, V b) { return _mm256_and_si256(a, b); }
+    static V either(V a, V b) { return _mm256_or_si256(a, b); }
+    static V differ(V a, V b) { return _mm256_xor_si256(a, b); }
+    static V add(V a, V b) { return _mm256_add_epi8(a, b); }
+    static V rank(V v) { return _mm256_and_si256(_mm256_srli_epi16(v, 2), splat(0xF)); }
+    static V select(V mask, V a, V b) { return _mm256_blendv_epi8(b, a, mask); }
+    static bool any(V mask) { return _mm256_movemask_epi8(mask) != 0; }
+};
+#elif defined(__SSE2__)
+struct SimdLanes {
+    typedef __m128i V;
+    static const int Width = 16;
+
+    static V load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint8_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static V splat(uint8_t x) { return _mm_set1_epi8(char(x)); }
+    static V eq(V a, V b) { return _mm_cmpeq_epi8(a, b); }
+    static V both(V a, V b) { return _mm_and_si128(a, b); }
+    static V either(V a, V b) { return _mm_or_si128(a, b); }
+    static V differ(V a, V b) { return _mm_xor_si128(a, b); }
+    static V add(V a, V b) { return _mm_add_epi8(a, b); }
+    static V rank(V v) { return _mm_and_si128(_mm_srli_epi16(v, 2), splat(0xF)); }
+    static V select(V mask, V a, V b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+    static bool any(V mask) { return _mm_movemask_epi8(mask) != 0; }
+};
+#else
+typedef ScalarLanes SimdLanes;
+#endif
+
+// Many independent greedy playouts advanced in lockstep, for Monte Carlo
+// runs over thousands of deals. Each game keeps its GameState, and next to
+// them the engine keeps structure-of-arrays rows: per pile, one byte per
+// game for the top card, the bottom of the face-up run and whether moving
+// that run turns a card over, plus rows for the waste top, the foundation
+// heights and whether the stock can be played. Every step one kernel pass
+// over those rows picks a move for all games at once, with the stacking
+// and foundation rules as lane compares, then the chosen moves are applied
+// game by game through MoveJournal and only the rows they touched are
+// refreshed.
+//
+// The policy follows Solver's move order for the moves it knows: foundation
+// moves, then moving a whole run to turn a card over, then emptying a
+// column, then waste to tableau, then the stock. It does not split runs.
+// Every move but a stock move makes progress, and the waste is only turned
+// over again after a pass that made some, so a game always ends.
+template <typename Rules, typename Lanes = SimdLanes>
+class BasicBatchPlayout {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef typename Lanes::V V;
+
+    static const int MaxPlayoutMoves = 1000;
+
+    BasicBatchPlayout(int capacity)
+        : capacity(capacity), stride((capacity + 31) & ~31), games(0), states(new GameState[capacity]),
+        moves(new int[capacity]), won(new uint8_t[capacity]), progress(new uint8_t[capacity]),
+        rows(new uint8_t[size_t(RowCount) * stride]) {}
+
+    ~BasicBatchPlayout() {
+        delete[] states;
+        delete[] moves;
+        delete[] won;
+        delete[] progress;
+        delete[] rows;
+    }
+
+    BasicBatchPlayout(const BasicBatchPlayout&) = delete;
+    BasicBatchPlayout& operator=(const BasicBatchPlayout&) = delete;
+
+    // Starts `count` games (capacity at most) from the given deals
+    void deal(const uint64_t* dealNumbers, int count) {
+        games = min(count, capacity);
+        memset(rows, 0, size_t(RowCount) * stride);
+        for (int g = 0; g < games; ++g) {
+            newDeal(states[g], dealNumbers[g]);
+            moves[g] = 0;
+            won[g] = 0;
+            progress[g] = 1;
+            row(Active)[g] = 0xFF;
+            for (int p = 0; p < GameState::TableauPiles; ++p) refreshPile(g, p);
+            refreshTalon(g);
+            refreshFoundations(g);
+        }
+    }
+
+    // Plays every game to its end; returns how many were won
+    int run() {
+        int active = games;
+        while (active > 0) {
+            for (int c = 0; c < games; c += Lanes::Width) {
+                choose(c);
+            }
+            for (int g = 0; g < games; ++g) {
+                if (row(Active)[g] && !step(g)) {
+                    row(Active)[g] = 0;
+                    --active;
+                }
+            }
+        }
+        int wins = 0;
+        for (int g = 0; g < games; ++g) wins += won[g];
+        return wins;
+    }
+
+    bool isWon(int g) const { return won[g] != 0; }
+    int getMoves(int g) const { return moves[g]; }
+
+private:
+    // Row indices; each row holds one byte per game
+    enum {
+        Top = 0,          // face-up top card of each pile, 0 when empty
+        Base = Top + 7,   // lowest card of the face-up run
+        Reveals = Base + 7, // 0xFF when moving that run turns a card over
+        Clears = Reveals + 7, // 0xFF when the run is the whole pile
+        Waste = Clears + 7,
+        Found = Waste + 1, // four rows of foundation heights
+        Stock = Found + 4, // 0xFF when the stock move may be played
+        Active = Stock + 1,
+        Choice = Active + 1,
+        RowCount = Choice + 1
+    };
+
+    // Move codes in Choice, from the lowest priority up
+    enum {
+        NoMove = 0,
+        StockMove = 1,
+        WasteToTableau = 2,                // + target pile
+        RunToTableau = WasteToTableau + 7, // + 7 * source + target
+        WasteToFoundation = RunToTableau + 49,
+        TableauToFoundation = WasteToFoundation + 1 // + source pile
+    };
+
+    uint8_t* row(int index) {
+        return rows + size_t(index) * stride;
+    }
+
+    V lanes(int index, int c) {
+        return Lanes::load(row(index) + c);
+    }
+
+    static V nonzero(V v) {
+        return Lanes::differ(Lanes::eq(v, Lanes::splat(0)), Lanes::splat(0xFF));
+    }
+
+    // `card` may go on `onto` in the tableau, or on an empty column
+    static V stacks(V card, V onto) {
+        V fits = Lanes::both(nonzero(onto), Lanes::eq(Lanes::add(Lanes::rank(card), Lanes::splat(1)), Lanes::rank(onto)));
+        if (Rules::StackOn == AlternateColors) {
+            fits = Lanes::both(fits, nonzero(Lanes::both(Lanes::differ(card, onto), Lanes::splat(2))));
+        }
+        else if (Rules::StackOn == SameSuit) {
+            fits = Lanes::both(fits, Lanes::eq(Lanes::both(Lanes::differ(card, onto), Lanes::splat(3)), Lanes::splat(0)));
+        }
+        V empty = Lanes::eq(onto, Lanes::splat(0));
+        if (Rules::EmptyColumn == KingsOnly) {
+            empty = Lanes::both(empty, Lanes::eq(Lanes::rank(card), Lanes::splat(Card::King)));
+        }
+        return Lanes::both(nonzero(card), Lanes::either(fits, empty));
+    }
+
+    // `card` is the next one its foundation takes
+    static V founds(V card, const V* heights) {
+        V suit = Lanes::both(card, Lanes::splat(3));
+        V height = Lanes::select(Lanes::eq(suit, Lanes::splat(0)), heights[0],
+            Lanes::select(Lanes::eq(suit, Lanes::splat(1)), heights[1],
+            Lanes::select(Lanes::eq(suit, Lanes::splat(2)), heights[2], heights[3])));
+        return Lanes::both(nonzero(card), Lanes::eq(Lanes::add(height, Lanes::splat(1)), Lanes::rank(card)));
+    }
+
+    // Picks the move for games [c, c + Width): each candidate in rising
+    // priority overwrites the choice where it is legal
+    void choose(int c) {
+        V choice = Lanes::both(lanes(Stock, c), Lanes::splat(StockMove));
+        V top[GameState::TableauPiles];
+        for (int p = 0; p < GameState::TableauPiles; ++p) top[p] = lanes(Top + p, c);
+
+        V waste = lanes(Waste, c);
+        for (int q = GameState::TableauPiles - 1; q >= 0; --q) {
+            choice = Lanes::select(stacks(waste, top[q]), Lanes::splat(uint8_t(WasteToTableau + q)), choice);
+        }
+        // Emptying a column onto another pile, then the better turning a card over
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int p = GameState::TableauPiles - 1; p >= 0; --p) {
+                V movable = lanes(pass ? Reveals + p : Clears + p, c);
+                if (!Lanes::any(movable)) continue;
+                V base = lanes(Base + p, c);
+                for (int q = GameState::TableauPiles - 1; q >= 0; --q) {
+                    if (q == p) continue;
+                    V onto = pass ? Lanes::splat(0xFF) : nonzero(top[q]);
+                    V fits = Lanes::both(Lanes::both(movable, onto), stacks(base, top[q]));
+                    choice = Lanes::select(fits, Lanes::splat(uint8_t(RunToTableau + 7 * p + q)), choice);
+                }
+            }
+        }
+        V heights[4];
+        for (int suit = 0; suit < 4; ++suit) heights[suit] = lanes(Found + suit, c);
+        choice = Lanes::select(founds(waste, heights), Lanes::splat(uint8_t(WasteToFoundation)), choice);
+        for (int p = GameState::TableauPiles - 1; p >= 0; --p) {
+            choice = Lanes::select(founds(top[p], heights), Lanes::splat(uint8_t(TableauToFoundation + p)), choice);
+        }
+        Lanes::store(row(Choice) + c, Lanes::both(choice, lanes(Active, c)));
+    }
+
+    // Plays game g's chosen move; false once the game is over
+    bool step(int g) {
+        int choice = row(Choice)[g];
+        if (choice == NoMove || moves[g] == MaxPlayoutMoves) return false;
+        GameState& s = states[g];
+        Move m;
+        if (choice == StockMove) {
+            if (!MoveGenerator::stockMove(s, m)) return false;
+        }
+        else if (choice < RunToTableau) {
+            m = Move{ Move::WastePile, uint8_t(choice - WasteToTableau), 1, 0 };
+        }
+        else if (choice < WasteToFoundation) {
+            int from = (choice - RunToTableau) / 7;
+            m = Move{ uint8_t(from), uint8_t((choice - RunToTableau) % 7),
+                uint8_t(s.tableauCount[from] - MoveGenerator::runStart(s, from)), 0 };
+        }
+        else if (choice == WasteToFoundation) {
+            m = Move{ Move::WastePile, uint8_t(Move::FoundationPile + (s.wasteTop() & 3)), 1, 0 };
+        }
+        else {
+            int from = choice - TableauToFoundation;
+            m = Move{ uint8_t(from), uint8_t(Move::FoundationPile + (s.tableau[from][s.tableauCount[from] - 1] & 3)), 1, 0 };
+        }
+        MoveJournal::apply(s, m);
+        Zobrist::verify(s);
+        ++moves[g];
+
+        if (m.to == Move::StockPile) progress[g] = 0;
+        else if (m.from != Move::StockPile) progress[g] = 1;
+        if (m.from < GameState::TableauPiles) refreshPile(g, m.from);
+        if (m.to < GameState::TableauPiles) refreshPile(g, m.to);
+        if (Move::isFoundation(m.to)) refreshFoundations(g);
+        refreshTalon(g);
+        if (BasicSolver<Rules>::isWon(s)) {
+            won[g] = 1;
+            return false;
+        }
+        return true;
+    }
+
+    void refreshPile(int g, int p) {
+        const GameState& s = states[g];
+        int count = s.tableauCount[p];
+        if (count == 0) {
+            row(Top + p)[g] = row(Base + p)[g] = row(Reveals + p)[g] = row(Clears + p)[g] = 0;
+            return;
+        }
+        int run = MoveGenerator::runStart(s, p);
+        row(Top + p)[g] = s.tableau[p][count - 1] & Card::IdentityMask;
+        row(Base + p)[g] = s.tableau[p][run] & Card::IdentityMask;
+        row(Reveals + p)[g] = run > 0 && !Card(s.tableau[p][run - 1]).isFaceUp() ? 0xFF : 0;
+        row(Clears + p)[g] = run == 0 ? 0xFF : 0;
+    }
+
+    void refreshTalon(int g) {
+        const GameState& s = states[g];
+        row(Waste)[g] = s.wasteTop() & Card::IdentityMask;
+        bool redeal = s.wasteCount && (Rules::Redeals < 0 || s.passes < Rules::Redeals) && progress[g];
+        row(Stock)[g] = s.stockCount() || redeal ? 0xFF : 0;
+    }
+
+    void refreshFoundations(int g) {
+        for (int suit = 0; suit < 4; ++suit) {
+            row(Found + suit)[g] = states[g].foundation[suit];
+        }
+    }
+
+    int capacity;
+    int stride; // row length, a whole number of the widest vector
+    int games;
+    GameState* states;
+    int* moves;
+    uint8_t* won;
+    uint8_t* progress; // a non-stock move since the waste was last turned over
+    uint8_t* rows;
+};
+
+// Plays a range of seeded deals headlessly on several threads. Deals are
+// handed out by work stealing over ranges: every worker owns a [begin, end)
+// range of deal indices packed into one atomic word, takes deals off the
+// front, and once it runs dry steals the back half of another worker's
+// range. Results are accumulated per worker and merged after the join, so
+// the only shared writes while playing are those range CASes.
+class Simulator {
+public:
+    enum Strategy { Random, Greedy, Solve, Batch };
+
+    struct Options {
+        uint64_t deals = 1000;
+        uint64_t firstDeal = 0;
+        int threads = 0; // 0 = one per hardware thread
+        Strategy strategy = Greedy;
+        uint64_t nodeLimit = 100000; // per deal, solver strategy only
+        string recordPath; // write every game to this record file when set
+        Variant rules = DrawOneVariant;
+    };
+
+    static const int MaxPlayoutMoves = 1000;
+    static const int HistogramBuckets = 40; // log2 of per-deal microseconds
+    static const int BatchGames = 256;      // deals played in lockstep by the batch strategy
+
+    // Positions seen during one playout, so greedy and random play never loop
+    struct SeenSet {
+        static const int Size = 4096;
+        uint64_t keys[Size];
+
+        void clear() {
+            memset(keys, 0, sizeof(keys));
+        }
+
+        bool insert(uint64_t key) {
+            if (key == 0) key = 1;
+            for (int probe = 0; probe < Size; ++probe) {
+                uint64_t& entry = keys[(key + probe) & (Size - 1)];
+                if (entry == key) return false;
+                if (entry == 0) {
+                    entry = key;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // Greedy takes the best-ordered move that reaches a new position, random
+    // picks uniformly among those
+    // `line`, when given, receives the moves played (MaxPlayoutMoves at most)
+    template <typename Rules = DrawOne>
+    static bool playout(GameState& s, Strategy strategy, SeenSet& seen, mt19937_64& rng, int& moves, Move* line = nullptr) {
+        typedef BasicMoveGenerator<Rules> MoveGenerator;
+        typedef BasicSolver<Rules> Solver;
+        seen.clear();
+        seen.insert(s.hash);
+        Move list[MoveGenerator::MaxMoves];
+        for (moves = 0; moves < MaxPlayoutMoves; ++moves) {
+            if (Solver::isWon(s)) return true;
+            int n = strategy == Random ? MoveGenerator::generateMoves(s, list) : Solver::orderedMoves(s, list);
+            int start = strategy == Random && n > 0 ? int(rng() % uint64_t(n)) : 0;
+            bool moved = false;
+            for (int k = 0; k < n && !moved; ++k) {
+                Move m = list[(start + k) % n];
+                MoveJournal::apply(s, m);
+                moved = seen.insert(s.hash);
+                if (!moved) MoveJournal::revert(s, m);
+                else if (line) line[moves] = m;
+            }
+            if (!moved) return false;
+        }
+        return Solver::isWon(s);
+    }
+
+    Simulator(const Options& o) : options(o), records(nullptr) {
+        if (options.threads <= 0) {
+            options.threads = max(1, int(thread::hardware_concurrency()));
+        }
+    }
+
+    void run() {
+        int n = options.threads;
+        uint64_t total = options.deals;
+        if (total > 0xFFFFFFFFull) total = 0xFFFFFFFFull; // indices are packed as 32 bits
+        Worker* workers = new Worker[n];
+        for (int i = 0; i < n; ++i) {
+            workers[i].range.store(pack(uint32_t(total * i / n), uint32_t(total * (i + 1) / n)));
+        }
+
+        if (!options.recordPath.empty() && options.strategy == Batch) {
+            cout << "Batch playouts keep no move lists; not writing " << options.recordPath << "\n";
+        }
+        else if (!options.recordPath.empty()) {
+            records = new RecordWriter(options.recordPath.c_str());
+            if (!records->isOpen()) {
+                cout << "Cannot write " << options.recordPath << "\n";
+                delete records;
+                records = nullptr;
+            }
+        }
+
+        auto begin = chrono::steady_clock::now();
+        thread* threads = new thread[n];
+        for (int i = 0; i < n; ++i) {
+            threads[i] = thread([this, workers, n, i]() {
+                withRules(options.rules, [&](auto rules) { work<decltype(rules)>(workers, n, i); });
+            });
+        }
+        for (int i = 0; i < n; ++i) {
+            threads[i].join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        delete[] threads;
+        delete records; // flushes and writes the index
+        records = nullptr;
+
+        Stats all;
+        for (int i = 0; i < n; ++i) {
+            all.merge(workers[i].stats);
+        }
+        delete[] workers;
+        report(all, seconds);
+    }
+
+private:
+    struct alignas(64) Stats {
+        uint64_t games = 0;
+        uint64_t wins = 0;
+        uint64_t moves = 0;
+        uint64_t nodes = 0;
+        uint64_t blocked = 0; // deals the solver proved lost without searching
+        uint64_t pruned = 0;
+        uint64_t nanos = 0;
+        uint64_t maxNanos = 0;
+        uint64_t histogram[HistogramBuckets] = {};
+
+        void addTime(uint64_t nanos) {
+            this->nanos += nanos;
+            maxNanos = max(maxNanos, nanos);
+            int bucket = 0;
+            for (uint64_t micros = nanos / 1000; micros > 1 && bucket < HistogramBuckets - 1; micros >>= 1) ++bucket;
+            histogram[bucket]++;
+        }
+
+        void merge(const Stats& other) {
+            games += other.games;
+            wins += other.wins;
+            moves += other.moves;
+            nodes += other.nodes;
+            blocked += other.blocked;
+            pruned += other.pruned;
+            nanos += other.nanos;
+            maxNanos = max(maxNanos, other.maxNanos);
+            for (int i = 0; i < HistogramBuckets; ++i) histogram[i] += other.histogram[i];
+        }
+    };
+
+    struct Worker {
+        alignas(64) atomic<uint64_t> range;
+        Stats stats;
+    };
+
+    static uint64_t pack(uint32_t begin, uint32_t end) {
+        return (uint64_t(begin) << 32) | end;
+    }
+
+    // Next deal index for worker `self`, stealing when its own range is empty
+    static bool next(Worker* workers, int n, int self, uint64_t& index) {
+        atomic<uint64_t>& own = workers[self].range;
+        while (true) {
+            uint64_t r = own.load(memory_order_acquire);
+            uint32_t b = uint32_t(r >> 32), e = uint32_t(r);
+            if (b >= e) break;
+            if (own.compare_exchange_weak(r, pack(b + 1, e), memory_order_acq_rel)) {
+                index = b;
+                return true;
+            }
+        }
+
+        for (int k = 1; k < n; ++k) {
+            atomic<uint64_t>& victim = workers[(self + k) % n].range;
+            uint64_t r = victim.load(memory_order_acquire);
+            while (true) {
+                uint32_t b = uint32_t(r >> 32), e = uint32_t(r);
+                if (b >= e) break;
+                uint32_t mid = b + (e - b) / 2; // a single remaining deal is taken whole
+                if (victim.compare_exchange_weak(r, pack(b, mid), memory_order_acq_rel)) {
+                    own.store(pack(mid + 1, e), memory_order_release);
+                    index = mid;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // The rules are a template parameter, so the whole deal loop is compiled per variant
+    template <typename Rules>
+    void work(Worker* workers, int n, int self) {
+        typedef BasicSolver<Rules> Solver;
+        if (options.strategy == Batch) {
+            workBatch<Rules>(workers, n, self);
+            return;
+        }
+        Stats& stats = workers[self].stats;
+        Solver* solver = options.strategy == Solve ? new Solver(20, options.nodeLimit) : nullptr;
+        typename Solver::Result* result = solver ? new typename Solver::Result : nullptr;
+        SeenSet* seen = new SeenSet;
+        Move* line = records ? new Move[MaxPlayoutMoves] : nullptr;
+        RecordWriter::Buffer* buffer = records ? records->acquire() : nullptr;
+
+        uint64_t index;
+        while (next(workers, n, self, index)) {
+            auto begin = chrono::steady_clock::now();
+            uint64_t dealNumber = options.firstDeal + index;
+
+            GameState s;
+            newDeal(s, dealNumber);
+
+            bool won;
+            int moves;
+            if (solver) {
+                solver->solve(s, *result);
+                won = result->status == Solver::Solved;
+                moves = result->moveCount;
+                stats.nodes += result->nodes;
+                stats.blocked += result->blocked;
+                stats.pruned += result->pruned;
+            }
+            else {
+                mt19937_64 rng(dealNumber);
+                won = playout<Rules>(s, options.strategy, *seen, rng, moves, line);
+            }
+
+            uint64_t nanos = uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+            stats.games++;
+            stats.wins += won;
+            stats.moves += moves;
+            stats.addTime(nanos);
+
+            if (records) {
+                GameRecord::Outcome outcome = won ? GameRecord::Won
+                    : solver && result->status == Solver::GaveUp ? GameRecord::Unknown : GameRecord::Lost;
+                uint32_t micros = uint32_t(min<uint64_t>(nanos / 1000, 0xFFFFFFFFu));
+                records->append(buffer, dealNumber, micros, outcome, solver ? result->moves : line, moves);
+            }
+        }
+
+        if (records) records->submit(buffer);
+        delete[] line;
+        delete seen;
+        delete result;
+        delete solver;
+    }
+
+    // Deals are claimed BatchGames at a time and played in lockstep; each
+    // game is charged an equal share of the batch's time
+    template <typename Rules>
+    void workBatch(Worker* workers, int n, int self) {
+        Stats& stats = workers[self].stats;
+        BasicBatchPlayout<Rules>* batch = new BasicBatchPlayout<Rules>(BatchGames);
+        uint64_t* deals = new uint64_t[BatchGames];
+        while (true) {
+            int count = 0;
+            uint64_t index;
+            while (count < BatchGames && next(workers, n, self, index)) {
+                deals[count++] = options.firstDeal + index;
+            }
+            if (count == 0) break;
+
+            auto begin = chrono::steady_clock::now();
+            batch->deal(deals, count);
+            stats.wins += batch->run();
+            uint64_t nanos = uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin).count());
+            for (int g = 0; g < count; ++g) {
+                stats.games++;
+                stats.moves += batch->getMoves(g);
+                stats.addTime(nanos / count);
+            }
+        }
+        delete[] deals;
+        delete batch;
+    }
+
+    void report(const Stats& all, double seconds) const {
+        const char* names[] = { "random", "greedy", "solver", "batch" };
+        uint64_t games = max<uint64_t>(all.games, 1);
+        cout << "Simulated " << all.games << " deals (" << variantNames[options.rules] << ", strategy " << names[options.strategy] << ", "
+            << options.threads << " threads) in " << seconds << " s: "
+            << uint64_t(all.games / max(seconds, 1e-9)) << " deals/s\n";
+        cout << "Wins: " << all.wins << " (" << 100.0 * all.wins / games << "%)\n";
+        cout << "Average moves per deal: " << double(all.moves) / games << "\n";
+        if (options.strategy == Solve) {
+            cout << "Average solver nodes per deal: " << double(all.nodes) / games << "\n";
+            cout << "Proved lost before searching: " << all.blocked << " deals (" << 100.0 * all.blocked / games
+                << "%); dead ends cut off: " << double(all.pruned) / games << " per deal\n";
+        }
+        cout << "Per-deal time: mean " << all.nanos / 1000.0 / games << " us, p50 < " << percentile(all, 0.50)
+            << " us, p99 < " << percentile(all, 0.99) << " us, max " << all.maxNanos / 1000.0 << " us\n";
+    }
+
+    // Upper bound of the histogram bucket holding the given fraction of deals
+    static uint64_t percentile(const Stats& all, double fraction) {
+        uint64_t target = uint64_t(all.games * fraction), seen = 0;
+        for (int i = 0; i < HistogramBuckets; ++i) {
+            seen += all.histogram[i];
+            if (seen > target) return uint64_t(2) << i;
+        }
+        return uint64_t(2) << (HistogramBuckets - 1);
+    }
+
+    Options options;
+    RecordWriter* records;
+};
+
+// Offline solver results per deal, for answering "is deal k winnable and
+// how hard is it" without a search. The file is a header followed by one
+// fixed-size entry per deal, sorted by deal number. A file built from one
+// contiguous range is dense, so a lookup indexes it directly; anything else
+// falls back to a binary search. Lookups read the mapped file in place.
+class SolvabilityDb {
+public:
+    static const uint64_t Magic = 0x3130425244534C4Full; // "OLSDRB01"
+
+    enum Verdict { Unwinnable = 0, Winnable = 1, Unknown = 2 }; // Unknown: the solver hit its node limit
+
+    struct Header {
+        uint64_t magic;
+        uint32_t rules;     // Variant
+        uint32_t unused;
+        uint64_t nodeLimit; // per deal
+        uint64_t count;
+    };
+
+    struct Entry {
+        uint64_t dealNumber;
+        uint32_t nodes;     // positions the solver expanded
+        uint16_t moveCount; // length of the solution found, 0 unless winnable
+        uint8_t verdict;
+        uint8_t unused;
+    };
+
+    struct BuildOptions {
+        uint64_t deals = 10000;
+        uint64_t firstDeal = 0;
+        int threads = 0; // 0 = one per hardware thread
+        uint64_t nodeLimit = 100000;
+        Variant rules = DrawOneVariant;
+    };
+
+    SolvabilityDb(const char* path) : base(nullptr), length(0), header(nullptr), entries(nullptr) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(Header)) {
+            length = size_t(info.st_size);
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            base = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+        }
+        ::close(fd);
+        if (!base) return;
+        header = reinterpret_cast<const Header*>(base);
+        if (header->magic != Magic || header->rules >= VariantCount
+            || header->count > (length - sizeof(Header)) / sizeof(Entry)) {
+            munmap(const_cast<char*>(base), length);
+            base = nullptr;
+            header = nullptr;
+            return;
+        }
+        entries = reinterpret_cast<const Entry*>(base + sizeof(Header));
+    }
+
+    ~SolvabilityDb() {
+        if (base) munmap(const_cast<char*>(base), length);
+    }
+
+    SolvabilityDb(const SolvabilityDb&) = delete;
+    SolvabilityDb& operator=(const SolvabilityDb&) = delete;
+
+    bool isOpen() const { return header != nullptr; }
+    uint64_t size() const { return header ? header->count : 0; }
+    Variant rules() const { return Variant(header->rules); }
+    uint64_t nodeLimit() const { return header->nodeLimit; }
+
+    // O(1) for a dense file, O(log n) otherwise
+    const Entry* lookup(uint64_t dealNumber) const {
+        uint64_t n = size();
+        if (n == 0) return nullptr;
+        uint64_t guess = dealNumber - entries[0].dealNumber;
+        if (dealNumber >= entries[0].dealNumber && guess < n && entries[guess].dealNumber == dealNumber) {
+            return &entries[guess];
+        }
+        uint64_t low = 0, high = n;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (entries[mid].dealNumber < dealNumber) low = mid + 1;
+            else high = mid;
+        }
+        return low < n && entries[low].dealNumber == dealNumber ? &entries[low] : nullptr;
+    }
+
+    // Solves options.deals consecutive deals on every core and writes the file
+    static bool build(const char* path, BuildOptions options) {
+        if (options.threads <= 0) {
+            options.threads = max(1, int(thread::hardware_concurrency()));
+        }
+        auto begin = chrono::steady_clock::now();
+        Entry* built = new Entry[options.deals];
+        atomic<uint64_t> next(0);
+        thread* threads = new thread[options.threads];
+        for (int i = 0; i < options.threads; ++i) {
+            threads[i] = thread([&]() {
+                withRules(options.rules, [&](auto rules) { solveRange<decltype(rules)>(options, built, next); });
+            });
+        }
+        for (int i = 0; i < options.threads; ++i) {
+            threads[i].join();
+        }
+        delete[] threads;
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+
+        FILE* file = fopen(path, "wb");
+        bool written = false;
+        if (file) {
+            Header h = { Magic, uint32_t(options.rules), 0, options.nodeLimit, options.deals };
+            written = fwrite(&h, sizeof(h), 1, file) == 1
+                && fwrite(built, sizeof(Entry), options.deals, file) == options.deals;
+            written = fclose(file) == 0 && written;
+        }
+
+        uint64_t counts[3] = { 0, 0, 0 };
+        for (uint64_t i = 0; i < options.deals; ++i) {
+            counts[built[i].verdict]++;
+        }
+        delete[] built;
+        cout << "Solved " << options.deals << " deals (" << variantNames[options.rules] << ") in " << seconds << " s: "
+            << counts[Winnable] << " winnable, " << counts[Unwinnable] << " unwinnable, " << counts[Unknown] << " unknown\n";
+        if (!written) cout << "Cannot write " << path << "\n";
+        return written;
+    }
+
+private:
+    static const uint64_t Chunk = 16; // deals claimed at a time
+
+    template <typename Rules>
+    static void solveRange(const BuildOptions& options, Entry* built, atomic<uint64_t>& next) {
+        typedef BasicSolver<Rules> Solver;
+        Solver* solver = new Solver(20, options.nodeLimit);
+        typename Solver::Result* result = new typename Solver::Result;
+        while (true) {
+            uint64_t start = next.fetch_add(Chunk, memory_order_relaxed);
+            if (start >= options.deals) break;
+            for (uint64_t i = start; i < min(start + Chunk, options.deals); ++i) {
+                GameState s;
+                newDeal(s, options.firstDeal + i);
+                solver->solve(s, *result);
+                Entry& e = built[i];
+                e.dealNumber = options.firstDeal + i;
+                e.nodes = uint32_t(min<uint64_t>(result->nodes, 0xFFFFFFFFu));
+                e.moveCount = uint16_t(result->status == Solver::Solved ? result->moveCount : 0);
+                e.verdict = uint8_t(result->status == Solver::Solved ? Winnable
+                    : result->status == Solver::Unwinnable ? Unwinnable : Unknown);
+                e.unused = 0;
+            }
+        }
+        delete result;
+        delete solver;
+    }
+
+    const char* base;
+    size_t length;
+    const Header* header;
+    const Entry* entries;
+};
+
+static_assert(sizeof(SolvabilityDb::Header) == 32 && sizeof(SolvabilityDb::Entry) == 16, "database layout is part of the file format");
+
+// Engine benchmarks, run with --bench. Each case is calibrated until one
+// sample takes at least MinSampleSeconds, that calibration doubles as the
+// warm-up, then it is timed `repeats` times and the median is reported.
+// Results can be written as JSON and compared against an earlier JSON run,
+// in which case any case slower than the tolerance fails the run.
+class Benchmark {
+public:
+    struct Options {
+        int repeats = 7;
+        string jsonPath;
+        string baselinePath;
+        double tolerance = 10.0; // percent
+        string filter;
+    };
+
+    static const int MaxResults = 64;
+    static const int MaxCounters = 16;
+    static const int MaxRepeats = 101;
+    static const int CorpusDeals = 32;
+    static const uint64_t CorpusNodeLimit = 100000;
+
+    Benchmark(const Options& o) : options(o), resultCount(0), counterCount(0) {
+        options.repeats = max(1, min(options.repeats, int(MaxRepeats)));
+    }
+
+    // Process exit code: 1 when a baseline regression was found
+    int run() {
+        GameState fresh;
+        fresh.clear();
+
+        measure("deal_generate", [](uint64_t n) {
+            uint8_t cards[52];
+            for (uint64_t i = 0; i < n; ++i) {
+                DealGenerator::deal(i, cards);
+                sink += cards[0];
+            }
+            return n;
+        });
+
+        measure("deck_construct", [&fresh](uint64_t n) {
+            GameState s = fresh;
+            for (uint64_t i = 0; i < n; ++i) {
+                Deck deck(s, i);
+                sink += s.talon[0];
+            }
+            return n;
+        });
+
+        measure("tableau_deal", [&fresh](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                GameState s = fresh;
+                Deck deck(s, i);
+                Tableau tableau(s, deck);
+                sink += s.hash;
+            }
+            return n;
+        });
+
+        measure("stack_push_pop", [&fresh](uint64_t n) {
+            GameState s = fresh;
+            Stack stack(s, 6);
+            for (uint64_t i = 0; i < n; ++i) {
+                stack.push(Card(int(i & 3), int(1 + i % 13)));
+                sink += stack.pop().getCode();
+            }
+            return n;
+        });
+
+        measure("stack_count", [](uint64_t n) {
+            GameState s;
+            newDeal(s, 1);
+            Stack stack(s, 6);
+            for (uint64_t i = 0; i < n; ++i) {
+                sink += stack.count();
+            }
+            return n;
+        });
+
+        // The engine side of each console move command: legality check, apply, and its undo
+        const char* moveNames[] = { "move_stock_to_waste", "move_waste_to_foundation", "move_waste_to_tableau",
+            "move_tableau_to_foundation", "move_tableau_to_tableau" };
+        for (int kind = 0; kind < 5; ++kind) {
+            GameState position;
+            Move move;
+            if (!findPosition(kind, position, move)) continue;
+            measure(moveNames[kind], [position, move](uint64_t n) {
+                GameState s = position;
+                for (uint64_t i = 0; i < n; ++i) {
+                    Move m = move;
+                    if (MoveGenerator::isLegal(s, m)) {
+                        MoveJournal::apply(s, m);
+                        MoveJournal::revert(s, m);
+                    }
+                    sink += s.hash;
+                }
+                return n;
+            });
+        }
+
+        GameState midGame;
+        Move line[Simulator::MaxPlayoutMoves];
+        int lineLength = recordPlayout<DrawOne>(7, midGame, line);
+
+        measure("journal_apply_revert", [&line, lineLength](uint64_t n) {
+            GameState s;
+            newDeal(s, 7);
+            uint64_t done = 0;
+            while (done < n && lineLength > 0) {
+                Move moves[Simulator::MaxPlayoutMoves];
+                for (int i = 0; i < lineLength; ++i) {
+                    moves[i] = line[i];
+                    MoveJournal::apply(s, moves[i]);
+                }
+                for (int i = lineLength - 1; i >= 0; --i) {
+                    MoveJournal::revert(s, moves[i]);
+                }
+                done += 2 * uint64_t(lineLength);
+            }
+            sink += s.hash;
+            return max<uint64_t>(done, 1);
+        });
+
+        // The rule-dependent cases once per variant; draw1 keeps the unsuffixed names
+        for (int v = 0; v < VariantCount; ++v) {
+            string suffix = v == DrawOneVariant ? "" : string("/") + variantNames[v];
+            withRules(Variant(v), [&](auto rules) { measureRules<decltype(rules)>(suffix); });
+        }
+
+        report();
+        if (!options.jsonPath.empty()) writeJson();
+        return options.baselinePath.empty() ? 0 : compareWithBaseline();
+    }
+
+    // Single-thread against parallel search on a fixed set of deals that
+    // take the draw-one solver several hundred thousand nodes: the first
+    // six are won, the last four proven lost
+    static void speedup(int threads) {
+        static const uint64_t hardDeals[] = { 121, 13, 79, 103, 41, 197, 169, 10, 171, 20 };
+        static const char* const verdicts[] = { "won", "lost", "gave up" };
+        Solver* single = new Solver;
+        ParallelSolver* parallel = new ParallelSolver(threads);
+        Solver::Result* result = new Solver::Result;
+        cout << "Parallel search on " << parallel->getThreads() << " threads\n";
+        cout << left << setw(8) << "deal" << right << setw(10) << "verdict" << setw(12) << "1 thread" << setw(12) << "nodes"
+            << setw(12) << "parallel" << setw(12) << "nodes" << setw(10) << "speedup" << "\n";
+        double singleTotal = 0, parallelTotal = 0;
+        for (uint64_t deal : hardDeals) {
+            GameState s;
+            newDeal(s, deal);
+            single->solve(s, *result);
+            double singleSeconds = result->seconds;
+            uint64_t singleNodes = result->nodes;
+            Solver::Status singleStatus = result->status;
+            parallel->solve(s, *result);
+            singleTotal += singleSeconds;
+            parallelTotal += result->seconds;
+            cout << left << setw(8) << deal << right << setw(10)
+                << (singleStatus == result->status ? verdicts[result->status] : "differs") << fixed << setprecision(1)
+                << setw(10) << singleSeconds * 1000 << "ms" << setw(12) << singleNodes
+                << setw(10) << result->seconds * 1000 << "ms" << setw(12) << result->nodes
+                << setw(9) << setprecision(2) << singleSeconds / result->seconds << "x\n";
+        }
+        cout << "Total " << setprecision(1) << singleTotal * 1000 << " ms -> " << parallelTotal * 1000 << " ms ("
+            << setprecision(2) << singleTotal / parallelTotal << "x)\n";
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+        delete result;
+        delete parallel;
+        delete single;
+    }
+
+private:
+    struct Result {
+        string name;
+        double medianNs;
+        double minNs;
+    };
+
+    // A count rather than a time, e.g. how much work a search did
+    struct Counter {
+        string name;
+        uint64_t value;
+    };
+
+    static constexpr double MinSampleSeconds = 0.05;
+    static volatile uint64_t sink; // keeps the optimizer from dropping benchmark bodies
+
+    // `body(n)` performs about n operations and returns how many it did
+    template <typename Body>
+    void measure(const char* name, Body body) {
+        if (!options.filter.empty() && string(name).find(options.filter) == string::npos) return;
+        if (resultCount == MaxResults) return;
+
+        uint64_t iterations = 1;
+        while (true) {
+            auto begin = chrono::steady_clock::now();
+            body(iterations);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            if (seconds >= MinSampleSeconds) break;
+            iterations *= seconds < MinSampleSeconds / 10 ? 10 : 2;
+        }
+
+        double samples[MaxRepeats];
+        for (int r = 0; r < options.repeats; ++r) {
+            auto begin = chrono::steady_clock::now();
+            uint64_t ops = body(iterations);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+            samples[r] = seconds * 1e9 / double(ops);
+        }
+        sort(samples, samples + options.repeats);
+
+        Result& result = results[resultCount++];
+        result.name = name;
+        result.medianNs = samples[options.repeats / 2];
+        result.minNs = samples[0];
+    }
+
+    void addCounter(const string& name, uint64_t value) {
+        if (counterCount == MaxCounters) return;
+        counters[counterCount].name = name;
+        counters[counterCount++].value = value;
+    }
+
+    template <typename Rules>
+    void measureRules(const string& suffix) {
+        typedef BasicMoveGenerator<Rules> MoveGenerator;
+        typedef BasicSolver<Rules> Solver;
+
+        GameState midGame;
+        Move line[Simulator::MaxPlayoutMoves];
+        recordPlayout<Rules>(7, midGame, line);
+
+        measure(("generate_moves" + suffix).c_str(), [midGame](uint64_t n) {
+            Move moves[MoveGenerator::MaxMoves];
+            for (uint64_t i = 0; i < n; ++i) {
+                sink += MoveGenerator::generateMoves(midGame, moves);
+            }
+            return n;
+        });
+
+        const Simulator::Strategy strategies[] = { Simulator::Random, Simulator::Greedy };
+        const char* playoutNames[] = { "playout_random", "playout_greedy" };
+        for (int k = 0; k < 2; ++k) {
+            Simulator::Strategy strategy = strategies[k];
+            measure((playoutNames[k] + suffix).c_str(), [strategy](uint64_t n) {
+                Simulator::SeenSet* seen = new Simulator::SeenSet;
+                for (uint64_t i = 0; i < n; ++i) {
+                    GameState s;
+                    newDeal(s, i % 64);
+                    mt19937_64 rng(i);
+                    int moves;
+                    sink += Simulator::playout<Rules>(s, strategy, *seen, rng, moves) + moves;
+                }
+                delete seen;
+                return n;
+            });
+        }
+
+        // Lockstep playouts, reported per game: the vector kernels and the
+        // same engine one lane at a time
+        measure(("playout_batch" + suffix).c_str(), [](uint64_t n) { return batchPlayouts<Rules, SimdLanes>(n); });
+        measure(("playout_batch_scalar" + suffix).c_str(), [](uint64_t n) { return batchPlayouts<Rules, ScalarLanes>(n); });
+
+        // The dead-deal proof the solver runs before searching, per deal
+        measure(("block_check" + suffix).c_str(), [](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                GameState s;
+                newDeal(s, i % 1024);
+                sink += BasicBlockDetector<Rules>::isBlocked(s);
+            }
+            return n;
+        });
+
+        // Reported per solver node
+        measure(("solver_node" + suffix).c_str(), [](uint64_t n) {
+            Solver* solver = new Solver(20, 100000);
+            typename Solver::Result* result = new typename Solver::Result;
+            uint64_t nodes = 0;
+            for (uint64_t deal = 0; nodes < n; ++deal) {
+                GameState s;
+                newDeal(s, deal % 16);
+                solver->solve(s, *result);
+                nodes += result->nodes;
+            }
+            delete result;
+            delete solver;
+            return nodes;
+        });
+
+        // Full searches over a fixed corpus, reported per deal. How many
+        // nodes one pass expands is also the transposition table fill, so
+        // that goes out as a counter next to the timing.
+        string corpusName = "solver_corpus" + suffix;
+        if (!options.filter.empty() && corpusName.find(options.filter) == string::npos) return;
+        measure(corpusName.c_str(), [](uint64_t n) {
+            Solver* solver = new Solver(20, CorpusNodeLimit);
+            typename Solver::Result* result = new typename Solver::Result;
+            for (uint64_t i = 0; i < n; ++i) {
+                GameState s;
+                newDeal(s, i % CorpusDeals);
+                solver->solve(s, *result);
+                sink += result->nodes;
+            }
+            delete result;
+            delete solver;
+            return n;
+        });
+
+        Solver* solver = new Solver(20, CorpusNodeLimit);
+        typename Solver::Result* result = new typename Solver::Result;
+        uint64_t nodes = 0, solved = 0, blocked = 0, pruned = 0;
+        for (uint64_t deal = 0; deal < CorpusDeals; ++deal) {
+            GameState s;
+            newDeal(s, deal);
+            solver->solve(s, *result);
+            nodes += result->nodes;
+            solved += result->status == Solver::Solved;
+            blocked += result->blocked;
+            pruned += result->pruned;
+        }
+        delete result;
+        delete solver;
+        addCounter(corpusName + "_nodes", nodes);
+        addCounter(corpusName + "_solved", solved);
+        addCounter(corpusName + "_blocked", blocked);
+        addCounter(corpusName + "_pruned", pruned);
+    }
+
+    template <typename Rules, typename Lanes>
+    static uint64_t batchPlayouts(uint64_t n) {
+        BasicBatchPlayout<Rules, Lanes>* batch = new BasicBatchPlayout<Rules, Lanes>(Simulator::BatchGames);
+        uint64_t deals[Simulator::BatchGames];
+        uint64_t done = 0;
+        while (done < n) {
+            for (int g = 0; g < Simulator::BatchGames; ++g) deals[g] = (done + g) % 1024;
+            batch->deal(deals, Simulator::BatchGames);
+            sink += batch->run();
+            done += Simulator::BatchGames;
+        }
+        delete batch;
+        return done;
+    }
+
+    // A position reached by greedy play where a move of the given console
+    // kind (same order as moveNames) is legal
+    static bool findPosition(int kind, GameState& position, Move& move) {
+        Simulator::SeenSet* seen = new Simulator::SeenSet;
+        bool found = false;
+        for (uint64_t deal = 0; deal < 1000 && !found; ++deal) {
+            GameState s;
+            newDeal(s, deal);
+            seen->clear();
+            Move moves[MoveGenerator::MaxMoves];
+            for (int step = 0; step < Simulator::MaxPlayoutMoves && !found; ++step) {
+                int n = MoveGenerator::generateMoves(s, moves);
+                for (int i = 0; i < n && !found; ++i) {
+                    const Move& m = moves[i];
+                    bool toFoundation = Move::isFoundation(m.to);
+                    int k = m.from == Move::StockPile ? 0
+                        : m.from == Move::WastePile ? (toFoundation ? 1 : 2)
+                        : (toFoundation ? 3 : 4);
+                    if (k == kind) {
+                        position = s;
+                        move = m;
+                        found = true;
+                    }
+                }
+                n = Solver::orderedMoves(s, moves);
+                bool moved = false;
+                for (int i = 0; i < n && !moved; ++i) {
+                    MoveJournal::apply(s, moves[i]);
+                    moved = seen->insert(s.hash);
+                    if (!moved) MoveJournal::revert(s, moves[i]);
+                }
+                if (!moved) break;
+            }
+        }
+        delete seen;
+        return found;
+    }
+
+    // Greedy line from a deal; `position` is where it ends up after half of it
+    template <typename Rules>
+    static int recordPlayout(uint64_t deal, GameState& position, Move* line) {
+        typedef BasicMoveGenerator<Rules> MoveGenerator;
+        typedef BasicSolver<Rules> Solver;
+        Simulator::SeenSet* seen = new Simulator::SeenSet;
+        seen->clear();
+        GameState s;
+        newDeal(s, deal);
+        GameState states[Simulator::MaxPlayoutMoves];
+        int length = 0;
+        Move moves[MoveGenerator::MaxMoves];
+        while (length < Simulator::MaxPlayoutMoves) {
+            int n = Solver::orderedMoves(s, moves);
+            bool moved = false;
+            for (int i = 0; i < n && !moved; ++i) {
+                states[length] = s;
+                Move m = moves[i];
+                MoveJournal::apply(s, m);
+                moved = seen->insert(s.hash);
+                if (moved) {
+                    line[length++] = moves[i];
+                }
+                else {
+                    MoveJournal::revert(s, m);
+                }
+            }
+            if (!moved) break;
+        }
+        position = length ? states[length / 2] : s;
+        delete seen;
+        return length;
+    }
+
+    void report() const {
+        cout << left << setw(30) << "benchmark" << right << setw(14) << "ns/op median" << setw(14) << "ns/op min"
+            << setw(16) << "ops/s" << "\n";
+        for (int i = 0; i < resultCount; ++i) {
+            const Result& r = results[i];
+            cout << left << setw(30) << r.name << right << fixed << setprecision(1) << setw(14) << r.medianNs
+                << setw(14) << r.minNs << setw(16) << uint64_t(1e9 / r.medianNs) << "\n";
+        }
+        if (counterCount) {
+            cout << "\n" << left << setw(30) << "counter" << right << setw(14) << "value" << "\n";
+            for (int i = 0; i < counterCount; ++i) {
+                cout << left << setw(30) << counters[i].name << right << setw(14) << counters[i].value << "\n";
+            }
+        }
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+    }
+
+    void writeJson() const {
+        ofstream out(options.jsonPath);
+        out << "{\n  \"repeats\": " << options.repeats << ",\n  \"benchmarks\": [\n";
+        for (int i = 0; i < resultCount; ++i) {
+            const Result& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.medianNs
+                << ", \"min_ns_per_op\": " << r.minNs << ", \"ops_per_sec\": " << 1e9 / r.medianNs << "}"
+                << (i + 1 < resultCount ? ",\n" : "\n");
+        }
+        out << "  ],\n  \"counters\": [\n";
+        for (int i = 0; i < counterCount; ++i) {
+            out << "    {\"name\": \"" << counters[i].name << "\", \"value\": " << counters[i].value << "}"
+                << (i + 1 < counterCount ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        cout << "Wrote " << options.jsonPath << "\n";
+    }
+
+    // Reads a file written by writeJson and flags cases that got slower
+    int compareWithBaseline() const {
+        ifstream in(options.baselinePath);
+        if (!in) {
+            cout << "Cannot read baseline " << options.baselinePath << "\n";
+            return 1;
+        }
+        stringstream buffer;
+        buffer << in.rdbuf();
+        string text = buffer.str();
+
+        int regressions = 0;
+        for (int i = 0; i < resultCount; ++i) {
+            const Result& r = results[i];
+            size_t at = text.find("\"name\": \"" + r.name + "\"");
+            if (at == string::npos) continue;
+            at = text.find("\"ns_per_op\": ", at);
+            if (at == string::npos) continue;
+            double baseline = strtod(text.c_str() + at + 13, nullptr);
+            double change = (r.medianNs - baseline) / baseline * 100.0;
+            bool regressed = change > options.tolerance;
+            regressions += regressed;
+            cout << r.name << ": " << baseline << " -> " << r.medianNs << " ns/op (" << (change >= 0 ? "+" : "")
+                << change << "%)" << (regressed ? "  REGRESSION" : "") << "\n";
+        }
+        return regressions ? 1 : 0;
+    }
+
+    Options options;
+    Result results[MaxResults];
+    int resultCount;
+    Counter counters[MaxCounters];
+    int counterCount;
+};
+
+volatile uint64_t Benchmark::sink;
+
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "--simulate") {
+        Simulator::Options options;
+        options.deals = argc > 2 ? strtoull(argv[2], nullptr, 10) : options.deals;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            string flag = argv[i], value = argv[i + 1];
+            if (flag == "--threads") {
+                options.threads = stoi(value);
+            }
+            else if (flag == "--first") {
+                options.firstDeal = strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (flag == "--nodes") {
+                options.nodeLimit = strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (flag == "--record") {
+                options.recordPath = value;
+            }
+            else if (flag == "--rules") {
+                if (!parseVariant(value, options.rules)) {
+                    cout << "Unknown rules " << value << " (draw1, draw3 or vegas)\n";
+                    return 1;
+                }
+            }
+            else if (flag == "--strategy" && (value == "random" || value == "greedy" || value == "solver" || value == "batch")) {
+                options.strategy = value == "random" ? Simulator::Random
+                    : value == "greedy" ? Simulator::Greedy : value == "solver" ? Simulator::Solve : Simulator::Batch;
+            }
+            else {
+                cout << "Unknown option " << flag << " " << value << "\n";
+                return 1;
+            }
+        }
+        Simulator(options).run();
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        Benchmark::Options options;
+        for (int i = 2; i + 1 < argc; i += 2) {
+            string flag = argv[i], value = argv[i + 1];
+            if (flag == "--repeat") {
+                options.repeats = stoi(value);
+            }
+            else if (flag == "--json") {
+                options.jsonPath = value;
+            }
+            else if (flag == "--baseline") {
+                options.baselinePath = value;
+            }
+            else if (flag == "--tolerance") {
+                options.tolerance = stod(value);
+            }
+            else if (flag == "--filter") {
+                options.filter = value;
+            }
+            else {
+                cout << "Unknown option " << flag << " " << value << "\n";
+                return 1;
+            }
+        }
+        return Benchmark(options).run();
+    }
+
+    if (argc > 1 && string(argv[1]) == "--speedup") {
+        int threads = argc > 3 && string(argv[2]) == "--threads" ? stoi(argv[3]) : 0;
+        Benchmark::speedup(threads);
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--serve") {
+        GameServer::Options options;
+        options.address = argv[2];
+        Variant rules = DrawOneVariant;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            string flag = argv[i], value = argv[i + 1];
+            if (flag == "--threads") {
+                options.threads = stoi(value);
+            }
+            else if (flag != "--rules" || !parseVariant(value, rules)) {
+                cout << "Unknown option " << flag << " " << value << "\n";
+                return 1;
+            }
+        }
+        return withRules(rules, [&](auto variant) {
+            typedef BasicGameServer<decltype(variant)> Server;
+            typename Server::Options serverOptions;
+            serverOptions.address = options.address;
+            serverOptions.threads = options.threads;
+            return Server(serverOptions).run();
+        });
+    }
+
+    if (argc > 2 && string(argv[1]) == "--build-db") {
+        SolvabilityDb::BuildOptions options;
+        options.deals = argc > 3 ? strtoull(argv[3], nullptr, 10) : options.deals;
+        for (int i = 4; i + 1 < argc; i += 2) {
+            string flag = argv[i], value = argv[i + 1];
+            if (flag == "--threads") {
+                options.threads = stoi(value);
+            }
+            else if (flag == "--first") {
+                options.firstDeal = strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (flag == "--nodes") {
+                options.nodeLimit = strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (flag != "--rules" || !parseVariant(value, options.rules)) {
+                cout << "Unknown option " << flag << " " << value << "\n";
+                return 1;
+            }
+        }
+        return SolvabilityDb::build(argv[2], options) ? 0 : 1;
+    }
+
+    if (argc > 4 && string(argv[1]) == "--db" && string(argv[3]) == "--deal") {
+        SolvabilityDb db(argv[2]);
+        if (!db.isOpen()) {
+            cout << "Cannot read database " << argv[2] << "\n";
+            return 1;
+        }
+        uint64_t dealNumber = strtoull(argv[4], nullptr, 10);
+        const SolvabilityDb::Entry* entry = db.lookup(dealNumber);
+        if (!entry) {
+            cout << "Deal " << dealNumber << " is not in the database\n";
+            return 1;
+        }
+        cout << "Deal " << dealNumber << " (" << variantNames[db.rules()] << "): ";
+        if (entry->verdict == SolvabilityDb::Winnable) cout << "winnable in " << entry->moveCount << " moves";
+        else if (entry->verdict == SolvabilityDb::Unwinnable) cout << "unwinnable";
+        else cout << "unknown, no verdict within " << db.nodeLimit() << " positions";
+        cout << " (" << entry->nodes << " positions searched)\n";
+        return 0;
+    }
+
+    if (argc > 2 && string(argv[1]) == "--records") {
+        bool single = argc > 4 && string(argv[3]) == "--game";
+        return showRecords(argv[2], single, single ? strtoull(argv[4], nullptr, 10) : 0);
+    }
+
+    if (argc > 2 && string(argv[1]) == "--script") {
+        uint64_t dealNumber = 0;
+        Variant rules = DrawOneVariant;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            string flag = argv[i], value = argv[i + 1];
+            if (flag == "--deal") {
+                dealNumber = strtoull(value.c_str(), nullptr, 10);
+            }
+            else if (flag != "--rules" || !parseVariant(value, rules)) {
+                cout << "Unknown option " << flag << " " << value << "\n";
+                return 1;
+            }
+        }
+        return withRules(rules, [&](auto variant) { return BasicScriptRunner<decltype(variant)>(dealNumber).run(argv[2]); });
+    }
+
+    bool seeded = false;
+    uint64_t dealNumber = 0;
+    Variant rules = DrawOneVariant;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--deal") {
+            seeded = true;
+            dealNumber = strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (flag != "--rules" || !parseVariant(value, rules)) {
+            cout << "Unknown option " << flag << " " << value << "\n";
+            return 1;
+        }
+    }
+    withRules(rules, [&](auto variant) {
+        typedef BasicSolitaire<decltype(variant)> Game;
+        Game solitaireGame(seeded ? dealNumber : Game::randomDealNumber());
+        solitaireGame.play();
+    });
     return 0;
 }
@@ -0,0 +1,1922 @@
+// Solitaire engine: positions, deals, move generation and application, the
+// rule variants, and the solver and hint searches on top of them. Nothing
+// in here does I/O, so it can be linked into anything; code.cpp is the
+// console, server and tools built on it. Engine at the bottom is the small
+// API for embedding. Everything is in namespace solitaire; std is not
+// imported, so including this changes no names for the includer.
+#ifndef SOLITAIRE_ENGINE_H
+#define SOLITAIRE_ENGINE_H
+
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <chrono>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <new>
+#include <utility>
+
+namespace solitaire {
+
+// Every card is a one byte code: bits 0-1 suit, bits 2-5 rank, bit 6 face-up.
+// Rank 0 never occurs, so code 0 doubles as "no card".
+class Card {
+public:
+    static const int Hearts = 0;
+    static const int Diamonds = 1;
+    static const int Clubs = 2;
+    static const int Spades = 3;
+
+    static const int Ace = 1;
+    static const int Two = 2;
+    static const int Three = 3;
+    static const int Four = 4;
+    static const int Five = 5;
+    static const int Six = 6;
+    static const int Seven = 7;
+    static const int Eight = 8;
+    static const int Nine = 9;
+    static const int Ten = 10;
+    static const int Jack = 11;
+    static const int Queen = 12;
+    static const int King = 13;
+
+    static const uint8_t FaceUpBit = 0x40;
+    static const uint8_t IdentityMask = 0x3F;
+
+    Card() : code(0) {}
+    Card(int s, int r) : code(static_cast<uint8_t>((r << 2) | s)) {}
+    explicit Card(uint8_t c) : code(c) {}
+
+    int getSuit() const { return code & 3; }
+    int getRank() const { return (code >> 2) & 0xF; }
+    bool isFaceUp() const { return (code & FaceUpBit) != 0; }
+    void flip() { code |= FaceUpBit; }
+    bool isNull() const { return code == 0; }
+    uint8_t getCode() const { return code; }
+    int getColor() const {
+        return (getSuit() == Hearts || getSuit() == Diamonds) ? 1 : 0; // 1 for red, 0 for black
+    }
+    std::string toString() const {
+        const char* suits[] = { "Hearts", "Diamonds", "Clubs", "Spades" };
+        const char* ranks[] = { "", "Ace", "Two", "Three", "Four", "Five", "Six", "Seven", "Eight", "Nine", "Ten", "Jack", "Queen", "King" };
+        return ranks[getRank()] + std::string(getColor() ? " (red)" : " (black)") + " " + suits[getSuit()];
+    }
+
+    std::string abbreviated() const {
+        const char* suits[] = { "H", "D", "C", "S" }; // Hearts, Diamonds, Clubs, Spades
+        const char* ranks[] = { "", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
+        return ranks[getRank()] + std::string(suits[getSuit()]);
+    }
+
+private:
+    uint8_t code;
+};
+
+// The whole position as a flat value. Piles are fixed arrays of card codes
+// (index 0 is the bottom card) with a length byte, foundations are just the
+// height reached per suit. Copying a position is a plain struct assignment.
+//
+// Stock and waste share one array, the talon: talon[0, wasteCount) is the
+// waste, bottom to top, and the rest is the stock, top card first. Drawing
+// only advances wasteCount and turning the waste over only resets it, so
+// both are O(1) whatever the draw count. Talon cards are stored face down;
+// whether one shows follows from which side of wasteCount it is on.
+struct GameState {
+    static const int TableauPiles = 7;
+    static const int MaxTableauCards = 19; // six face-down cards plus King..Ace
+    static const int DeckSize = 52;
+    static const int MaxTalonCards = 24;   // everything left after the deal
+    static const int MaxPasses = 16;       // redeals counted, see RuleSet
+
+    uint64_t hash; // Zobrist key, kept up to date by every mutation; the same whatever order the columns are in
+    uint64_t columns[TableauPiles]; // each column's own Zobrist key
+    uint64_t columnSum;             // what the columns contribute to hash, see Zobrist
+    uint8_t tableau[TableauPiles][MaxTableauCards];
+    uint8_t tableauCount[TableauPiles];
+    uint8_t talon[MaxTalonCards];
+    uint8_t talonCount;
+    uint8_t wasteCount;
+    uint8_t foundation[4];
+    uint8_t passes; // times the waste was turned back into the stock, under a redeal limit
+
+    void clear() {
+        std::memset(this, 0, sizeof(*this));
+    }
+
+    int stockCount() const {
+        return talonCount - wasteCount;
+    }
+
+    // Face-up code of the waste's top card, 0 when the waste is empty
+    uint8_t wasteTop() const {
+        return wasteCount ? uint8_t(talon[wasteCount - 1] | Card::FaceUpBit) : 0;
+    }
+};
+
+static_assert(std::is_trivially_copyable<GameState>::value, "GameState must stay memcpy-able");
+static_assert(sizeof(GameState) <= 4 * 64, "GameState should fit in a few cache lines");
+
+// Random keys for incremental position hashing. A tableau card contributes
+// a key for its depth in the pile plus a per-card key while it is face up, a
+// foundation contributes one key per (suit, height) and the redeal count one
+// key per value. The talon is hashed by its neighbouring pairs (0 stands for
+// either end) plus a key for the waste/stock boundary, so taking a card out
+// of the middle of it changes three keys however many cards sit behind it.
+// Every change to a position touches a handful of keys, so keeping
+// GameState::hash current is O(1) per move.
+//
+// Each column has a key of its own, made of the depth keys of its cards
+// and kept in GameState::columns. The hash takes the sum of those keys
+// after a nonlinear mix, so it does not change with the order of the
+// columns: a King run in column 2 or in column 5, empty columns wherever
+// they are. Those play out identically, and every table keyed by the hash
+// (solver, hint engine, playouts) sees them as one position. The mix keeps
+// which cards share a column: moving cards from one column to another
+// changes the sum, where XORing depth keys into one word would not. A move
+// re-mixes only the columns it touches.
+class Zobrist {
+public:
+    static const int Slots = GameState::MaxTableauCards;
+
+    // A tableau card at the given depth in its column
+    static uint64_t card(int depth, uint8_t code) {
+        int identity = code & Card::IdentityMask;
+        uint64_t key = table.slot[depth][identity];
+        return (code & Card::FaceUpBit) ? key ^ table.faceUp[identity] : key;
+    }
+
+    static uint64_t faceUp(uint8_t code) {
+        return table.faceUp[code & Card::IdentityMask];
+    }
+
+    static uint64_t foundation(int suit, int height) {
+        return table.foundation[suit][height];
+    }
+
+    static uint64_t passes(int count) {
+        return table.passes[count];
+    }
+
+    // Where the waste ends in the talon
+    static uint64_t waste(int count) {
+        return table.waste[count];
+    }
+
+    // Talon card `next` directly after `previous`; either may be 0 for an end
+    static uint64_t link(uint8_t previous, uint8_t next) {
+        return table.link[previous & Card::IdentityMask][next & Card::IdentityMask];
+    }
+
+    static uint64_t talon(const uint8_t* cards, int count) {
+        uint64_t h = link(0, count ? cards[0] : 0);
+        for (int j = 0; j < count; ++j) {
+            h ^= link(cards[j], j + 1 < count ? cards[j + 1] : 0);
+        }
+        return h;
+    }
+
+    // A column key's share of the hash. splitmix64's finalizer: nonlinear,
+    // and an empty column (key 0) adds nothing.
+    static uint64_t mix(uint64_t key) {
+        key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ull;
+        key = (key ^ (key >> 27)) * 0x94D049BB133111EBull;
+        return key ^ (key >> 31);
+    }
+
+    // Gives column `pile` a new key, keeping columnSum and hash in step
+    static void setColumn(GameState& s, int pile, uint64_t key) {
+        uint64_t sum = s.columnSum - mix(s.columns[pile]) + mix(key);
+        s.hash ^= s.columnSum ^ sum;
+        s.columnSum = sum;
+        s.columns[pile] = key;
+    }
+
+    static uint64_t column(const uint8_t* cards, int count) {
+        uint64_t key = 0;
+        for (int j = 0; j < count; ++j) key ^= card(j, cards[j]);
+        return key;
+    }
+
+    // From-scratch hash, the reference the incremental updates must match
+    static uint64_t compute(const GameState& s) {
+        uint64_t sum = 0;
+        for (int i = 0; i < GameState::TableauPiles; ++i) {
+            sum += mix(column(s.tableau[i], s.tableauCount[i]));
+        }
+        uint64_t h = sum ^ talon(s.talon, s.talonCount) ^ waste(s.wasteCount);
+        for (int suit = 0; suit < 4; ++suit) {
+            h ^= foundation(suit, s.foundation[suit]);
+        }
+        return h ^ passes(s.passes);
+    }
+
+    // Debug builds (-DSOLITAIRE_DEBUG_HASH) check the incremental hash after
+    // every move; otherwise this compiles to nothing.
+    static void verify(const GameState& s) {
+#ifdef SOLITAIRE_DEBUG_HASH
+        for (int i = 0; i < GameState::TableauPiles; ++i) {
+            assert(s.columns[i] == column(s.tableau[i], s.tableauCount[i]) && "column key out of sync");
+        }
+        assert(s.hash == compute(s) && "incremental Zobrist hash out of sync");
+#else
+        (void)s;
+#endif
+    }
+
+private:
+    struct Keys {
+        uint64_t slot[Slots][Card::IdentityMask + 1];
+        uint64_t faceUp[Card::IdentityMask + 1];
+        uint64_t foundation[4][14];
+        uint64_t passes[GameState::MaxPasses];
+        uint64_t waste[GameState::MaxTalonCards + 1];
+        uint64_t link[Card::IdentityMask + 1][Card::IdentityMask + 1];
+
+        Keys() {
+            uint64_t seed = 0x2545F4914F6CDD1Dull;
+            auto next = [&seed]() { // splitmix64, fixed seed so keys are stable across runs
+                uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            };
+            for (auto& row : slot) {
+                for (auto& key : row) key = next();
+            }
+            for (auto& key : faceUp) key = next();
+            for (auto& row : foundation) {
+                row[0] = 0; // an empty foundation contributes nothing
+                for (int h = 1; h < 14; ++h) row[h] = next();
+            }
+            passes[0] = 0; // drawn after the older keys so those stay the same
+            for (int i = 1; i < GameState::MaxPasses; ++i) passes[i] = next();
+            waste[0] = 0;
+            for (int i = 1; i <= GameState::MaxTalonCards; ++i) waste[i] = next();
+            for (auto& row : link) {
+                for (auto& key : row) key = next();
+            }
+            link[0][0] = 0; // an empty talon contributes nothing
+        }
+    };
+
+    static const Keys table;
+};
+
+inline const Zobrist::Keys Zobrist::table;
+
+// A tableau column inside a GameState: card array plus its length byte.
+// The view does not own anything, so it is only valid while the state it
+// points into is. Every change updates the column's key and the hash.
+class Stack {
+public:
+    Stack() : state(nullptr), pile(0), cards(nullptr), size(nullptr) {}
+    Stack(GameState& s, int p) : state(&s), pile(p), cards(s.tableau[p]), size(&s.tableauCount[p]) {}
+
+    void push(Card card) {
+        Zobrist::setColumn(*state, pile, state->columns[pile] ^ Zobrist::card(*size, card.getCode()));
+        cards[(*size)++] = card.getCode();
+    }
+
+    // The vacated slot is cleared so equal positions are equal byte for byte
+    Card pop() {
+        if (isEmpty()) return Card();
+        Card card(cards[--(*size)]);
+        cards[*size] = 0;
+        Zobrist::setColumn(*state, pile, state->columns[pile] ^ Zobrist::card(*size, card.getCode()));
+        return card;
+    }
+
+    Card peek() const {
+        return isEmpty() ? Card() : Card(cards[*size - 1]);
+    }
+
+    // 0 is the bottom of the pile
+    Card at(int index) const {
+        return Card(cards[index]);
+    }
+
+    void flipTop() {
+        if (isEmpty() || Card(cards[*size - 1]).isFaceUp()) return;
+        cards[*size - 1] |= Card::FaceUpBit;
+        Zobrist::setColumn(*state, pile, state->columns[pile] ^ Zobrist::faceUp(cards[*size - 1]));
+    }
+
+    bool isEmpty() const {
+        return *size == 0;
+    }
+
+    int count() const {
+        return *size;
+    }
+
+private:
+    GameState* state;
+    int pile;
+    uint8_t* cards;
+    uint8_t* size;
+};
+
+// Deal number k always produces the same card order, and computing it needs
+// nothing but k: the random stream is a counter-based generator (a
+// splitmix64 finalizer over k and the draw index), so any worker can jump
+// straight to any deal. Shuffling is a Fisher-Yates pass over 52 bytes.
+class DealGenerator {
+public:
+    static uint64_t random(uint64_t dealNumber, uint64_t counter) {
+        uint64_t z = dealNumber * 0x9E3779B97F4A7C15ull + (counter + 1) * 0xD1B54A32D192ED03ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Fills `cards` with the 52 face-down card codes of the deal, in the order
+    // they are pushed onto the stock (the last one is dealt first)
+    static void deal(uint64_t dealNumber, uint8_t cards[52]) {
+        int index = 0;
+        for (int suit = 0; suit < 4; ++suit) {
+            for (int rank = 1; rank <= 13; ++rank) {
+                cards[index++] = Card(suit, rank).getCode();
+            }
+        }
+        for (int i = 51; i > 0; --i) {
+            // high 32 bits scaled into [0, i], bias is below 2^-26
+            int j = int(((random(dealNumber, uint64_t(i)) >> 32) * uint64_t(i + 1)) >> 32);
+            uint8_t t = cards[i];
+            cards[i] = cards[j];
+            cards[j] = t;
+        }
+    }
+};
+
+// The shuffled deck of one deal. The cards the tableau does not take go
+// straight into the state's talon as the stock; deal() hands out the others,
+// top of the deck first, for Tableau to lay out.
+class Deck {
+public:
+    static const int TableauCards = GameState::DeckSize - GameState::MaxTalonCards;
+
+    Deck(GameState& s, uint64_t dealNumber) : state(s), remaining(0) {
+        shuffle(dealNumber);
+    }
+
+    // Replaces the talon with the stock of the deal and refills the cards to deal
+    void shuffle(uint64_t dealNumber) {
+        DealGenerator::deal(dealNumber, cards);
+        state.hash ^= Zobrist::talon(state.talon, state.talonCount) ^ Zobrist::waste(state.wasteCount);
+        state.talonCount = GameState::MaxTalonCards;
+        state.wasteCount = 0;
+        for (int i = 0; i < GameState::MaxTalonCards; ++i) {
+            // cards[] is pushed in order, so the last card left for the stock is its top
+            state.talon[i] = cards[GameState::MaxTalonCards - 1 - i];
+        }
+        state.hash ^= Zobrist::talon(state.talon, state.talonCount);
+        remaining = TableauCards;
+    }
+
+    Card deal() {
+        return remaining ? Card(cards[GameState::MaxTalonCards + --remaining]) : Card();
+    }
+
+    int cardsRemaining() const {
+        return remaining;
+    }
+
+private:
+    GameState& state;
+    uint8_t cards[GameState::DeckSize];
+    int remaining;
+};
+
+class Tableau {
+public:
+    Tableau(GameState& state) {
+        for (int i = 0; i < 7; ++i) {
+            tableauStacks[i] = Stack(state, i);
+        }
+    }
+
+    Tableau(GameState& state, Deck& deck) : Tableau(state) {
+        for (int i = 0; i < 7; ++i) {
+            while (!tableauStacks[i].isEmpty()) {
+                tableauStacks[i].pop();
+            }
+        }
+        for (int i = 0; i < 7; ++i) {
+            for (int j = 0; j <= i; ++j) {
+                Card card = deck.deal();
+                if (j == i) {
+                    card.flip();  // Only the top card is face up
+                }
+                tableauStacks[i].push(card);
+            }
+        }
+    }
+
+    Card peek(int index) {
+        if (index < 0 || index >= 7) {
+
+            throw std::out_of_range("Index out of bounds");
+        }
+
+        return tableauStacks[index].peek();
+    }
+
+    // Null card when the pile is empty
+    Card peekTopCard(int index) {
+        if (index < 0 || index >= 7) return Card();
+        return tableauStacks[index].peek();
+    }
+
+    Card removeTopCard(int index) {
+        if (index < 0 || index >= 7) return Card();
+        Card card = tableauStacks[index].pop();
+        tableauStacks[index].flipTop(); // Flip the new top card if it exists
+        return card;
+    }
+
+    void pushCard(int index, Card card) {
+        if (index < 0 || index >= 7 || card.isNull()) return;
+        if (tableauStacks[index].count() == GameState::MaxTableauCards) return;
+        tableauStacks[index].push(card);
+    }
+
+private:
+    Stack tableauStacks[7];
+};
+
+class Foundation {
+public:
+    Foundation(GameState& state) : heights(state.foundation), hash(&state.hash) {}
+
+    // Top card of the pile for suit `index`, null card when empty
+    Card peek(int index) const {
+        if (heights[index] == 0) return Card();
+        Card card(index, heights[index]);
+        card.flip();
+        return card;
+    }
+
+    bool isEmpty() const {
+        // Check if any foundation stack is empty
+        for (int i = 0; i < 4; ++i) {
+            if (heights[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool moveToFoundation(Card card) {
+        // If no card is provided, exit the function
+        if (card.isNull()) return false;
+
+        // Foundations are built per suit, Ace first, each card one rank above the previous
+        int suitIndex = card.getSuit();
+        if (heights[suitIndex] != card.getRank() - 1) return false;
+        *hash ^= Zobrist::foundation(suitIndex, heights[suitIndex]) ^ Zobrist::foundation(suitIndex, heights[suitIndex] + 1);
+        heights[suitIndex]++;
+        return true;
+    }
+
+    int count() const {
+        return heights[0] + heights[1] + heights[2] + heights[3];
+    }
+
+private:
+    uint8_t* heights;
+    uint64_t* hash;
+};
+
+// Resets `s` to the opening position of deal #dealNumber
+inline void newDeal(GameState& s, uint64_t dealNumber) {
+    s.clear();
+    Deck deck(s, dealNumber);
+    Tableau tableau(s, deck);
+}
+
+// A single step of play. Piles 0-6 are the tableau columns, then the stock,
+// the waste and one foundation per suit. For a stock draw `count` is how far
+// the stock/waste boundary moves; turning the waste back over is a move from
+// the waste to the stock of the whole waste. `flipped` is filled in by
+// MoveJournal::apply when the move turns over a face-down tableau card, so
+// the move carries everything needed to take it back. On a recycle it is set
+// by the move generator instead and says whether the pass counts against a
+// redeal limit.
+struct Move {
+    static const uint8_t StockPile = 7;
+    static const uint8_t WastePile = 8;
+    static const uint8_t FoundationPile = 9; // + suit
+
+    uint8_t from;
+    uint8_t to;
+    uint8_t count; // cards moved: tableau runs, draw-N and recycles move more than one
+    uint8_t flipped;
+
+    static bool isFoundation(uint8_t pile) {
+        return pile >= FoundationPile;
+    }
+
+    static std::string pileName(uint8_t pile) {
+        if (pile == StockPile) return "Stock";
+        if (pile == WastePile) return "Waste";
+        if (isFoundation(pile)) return "Foundation";
+        return "Tableau " + std::to_string(pile + 1);
+    }
+
+    // The console command that performs this move
+    std::string toCommand() const {
+        if (from == StockPile || to == StockPile) return "mv";
+        if (from == WastePile) {
+            return isFoundation(to) ? "wf" : "wt " + std::to_string(to + 1);
+        }
+        if (isFoundation(to)) return "mt " + std::to_string(from + 1);
+        std::string command = "mt " + std::to_string(from + 1) + " " + std::to_string(to + 1);
+        if (count > 1) command += " (" + std::to_string(count) + " cards)";
+        return command;
+    }
+};
+
+// Exact, allocation-free do/undo of moves on a GameState. apply() and
+// revert() are inverses down to the byte (hash included) and each costs a
+// few stores per card moved. An instance keeps a bounded stack of applied
+// moves for search; the static pair works on any state.
+class MoveJournal {
+public:
+    static const int Capacity = 1024;
+
+    MoveJournal(GameState& s) : state(s), size(0) {}
+
+    void apply(Move m) {
+        apply(state, m);
+        moves[size++] = m;
+    }
+
+    Move undo() {
+        Move m = moves[--size];
+        revert(state, m);
+        return m;
+    }
+
+    bool isFull() const { return size == Capacity; }
+    int getSize() const { return size; }
+    const Move& at(int index) const { return moves[index]; }
+    void clear() { size = 0; }
+
+    static void apply(GameState& s, Move& m) {
+        if (m.to == Move::StockPile) {
+            // Turn the waste over: the waste's bottom card is the new stock top, so the talon stays as it is
+            moveBoundary(s, 0);
+            if (m.flipped) {
+                s.hash ^= Zobrist::passes(s.passes) ^ Zobrist::passes(s.passes + 1);
+                s.passes++;
+            }
+            return;
+        }
+
+        m.flipped = 0;
+        if (m.from == Move::StockPile) {
+            moveBoundary(s, s.wasteCount + m.count);
+            return;
+        }
+
+        if (m.from == Move::WastePile) {
+            place(s, m.to, takeWaste(s));
+            return;
+        }
+
+        uint8_t* pile = s.tableau[m.from];
+        uint8_t& count = s.tableauCount[m.from];
+        if (Move::isFoundation(m.to)) {
+            place(s, m.to, take(s, m.from));
+        }
+        else {
+            shift(s, m.from, m.to, m.count);
+        }
+        if (count && !Card(pile[count - 1]).isFaceUp()) {
+            pile[count - 1] |= Card::FaceUpBit;
+            Zobrist::setColumn(s, m.from, s.columns[m.from] ^ Zobrist::faceUp(pile[count - 1]));
+            m.flipped = 1;
+        }
+    }
+
+    static void revert(GameState& s, const Move& m) {
+        if (m.to == Move::StockPile) {
+            moveBoundary(s, m.count);
+            if (m.flipped) {
+                s.hash ^= Zobrist::passes(s.passes) ^ Zobrist::passes(s.passes - 1);
+                s.passes--;
+            }
+            return;
+        }
+
+        if (m.from == Move::StockPile) {
+            moveBoundary(s, s.wasteCount - m.count);
+            return;
+        }
+
+        if (m.from == Move::WastePile) {
+            putWaste(s, unplace(s, m.to));
+            return;
+        }
+
+        uint8_t* pile = s.tableau[m.from];
+        uint8_t count = s.tableauCount[m.from];
+        if (m.flipped) {
+            Zobrist::setColumn(s, m.from, s.columns[m.from] ^ Zobrist::faceUp(pile[count - 1]));
+            pile[count - 1] &= ~Card::FaceUpBit;
+        }
+        if (Move::isFoundation(m.to)) {
+            put(s, m.from, unplace(s, m.to));
+        }
+        else {
+            shift(s, m.to, m.from, m.count);
+        }
+    }
+
+private:
+    static void moveBoundary(GameState& s, int wasteCount) {
+        s.hash ^= Zobrist::waste(s.wasteCount) ^ Zobrist::waste(wasteCount);
+        s.wasteCount = uint8_t(wasteCount);
+    }
+
+    // Removes the waste's top card; the stock behind it slides down one slot
+    static uint8_t takeWaste(GameState& s) {
+        int top = s.wasteCount - 1;
+        uint8_t card = s.talon[top];
+        uint8_t previous = top ? s.talon[top - 1] : 0;
+        uint8_t next = top + 1 < s.talonCount ? s.talon[top + 1] : 0;
+        s.hash ^= Zobrist::link(previous, card) ^ Zobrist::link(card, next) ^ Zobrist::link(previous, next);
+        std::memmove(s.talon + top, s.talon + top + 1, size_t(s.talonCount - top - 1));
+        s.talon[--s.talonCount] = 0;
+        moveBoundary(s, top);
+        return card | Card::FaceUpBit;
+    }
+
+    static void putWaste(GameState& s, uint8_t card) {
+        card &= ~Card::FaceUpBit;
+        int top = s.wasteCount;
+        uint8_t previous = top ? s.talon[top - 1] : 0;
+        uint8_t next = top < s.talonCount ? s.talon[top] : 0;
+        s.hash ^= Zobrist::link(previous, next) ^ Zobrist::link(previous, card) ^ Zobrist::link(card, next);
+        std::memmove(s.talon + top + 1, s.talon + top, size_t(s.talonCount - top));
+        s.talon[top] = card;
+        s.talonCount++;
+        moveBoundary(s, top + 1);
+    }
+
+    static uint8_t take(GameState& s, int pile) {
+        uint8_t& count = s.tableauCount[pile];
+        uint8_t card = s.tableau[pile][--count];
+        s.tableau[pile][count] = 0;
+        Zobrist::setColumn(s, pile, s.columns[pile] ^ Zobrist::card(count, card));
+        return card;
+    }
+
+    static void put(GameState& s, int pile, uint8_t card) {
+        uint8_t& count = s.tableauCount[pile];
+        Zobrist::setColumn(s, pile, s.columns[pile] ^ Zobrist::card(count, card));
+        s.tableau[pile][count++] = card;
+    }
+
+    // Single card onto a foundation or tableau pile
+    static void place(GameState& s, uint8_t pile, uint8_t card) {
+        if (Move::isFoundation(pile)) {
+            int suit = pile - Move::FoundationPile;
+            s.hash ^= Zobrist::foundation(suit, s.foundation[suit]) ^ Zobrist::foundation(suit, s.foundation[suit] + 1);
+            s.foundation[suit]++;
+        }
+        else {
+            put(s, pile, card);
+        }
+    }
+
+    static uint8_t unplace(GameState& s, uint8_t pile) {
+        if (Move::isFoundation(pile)) {
+            int suit = pile - Move::FoundationPile;
+            s.hash ^= Zobrist::foundation(suit, s.foundation[suit]) ^ Zobrist::foundation(suit, s.foundation[suit] - 1);
+            return Card(suit, s.foundation[suit]--).getCode() | Card::FaceUpBit;
+        }
+        return take(s, pile);
+    }
+
+    // Moves the top `n` cards of tableau pile `from` onto pile `to`, keeping
+    // their order; the two column keys are re-mixed once at the end
+    static void shift(GameState& s, int from, int to, int n) {
+        uint8_t* src = s.tableau[from];
+        uint8_t* dst = s.tableau[to];
+        uint8_t& srcCount = s.tableauCount[from];
+        uint8_t& dstCount = s.tableauCount[to];
+        uint64_t fromKey = s.columns[from], toKey = s.columns[to];
+        srcCount -= n;
+        for (int k = 0; k < n; ++k) {
+            uint8_t card = src[srcCount + k];
+            src[srcCount + k] = 0;
+            fromKey ^= Zobrist::card(srcCount + k, card);
+            toKey ^= Zobrist::card(dstCount, card);
+            dst[dstCount++] = card;
+        }
+        Zobrist::setColumn(s, from, fromKey);
+        Zobrist::setColumn(s, to, toKey);
+    }
+
+    GameState& state;
+    Move moves[Capacity];
+    int size;
+};
+
+// Rule variants as compile-time policies. Each preset is a type, and the
+// move generator and everything searching on top of it are class templates
+// over that type. The rules therefore fold into the generated code and the
+// inner loops never branch on which game is being played. Redeals counts how
+// often the waste may be turned back into the stock (-1: no limit).
+enum StackRule { AlternateColors, SameSuit, AnySuit };
+enum EmptyColumnRule { KingsOnly, AnyCard };
+
+template <int DrawCount, int RedealLimit, StackRule Stacking = AlternateColors, EmptyColumnRule EmptyColumns = KingsOnly>
+struct RuleSet {
+    static constexpr int Draw = DrawCount;
+    static constexpr int Redeals = RedealLimit;
+    static constexpr StackRule StackOn = Stacking;
+    static constexpr EmptyColumnRule EmptyColumn = EmptyColumns;
+
+    static_assert(Draw >= 1 && Draw <= GameState::MaxTalonCards, "draw count out of range");
+    static_assert(Redeals < GameState::MaxPasses, "redeal count is hashed in GameState::passes");
+};
+
+struct DrawOne : RuleSet<1, 0> {}; // the console's classic game: single pass, one card at a time
+struct DrawThree : RuleSet<3, -1> {};
+struct DrawThreeVegas : RuleSet<3, 2> {}; // three passes through the stock
+
+// Run-time names of the presets, for command lines. withRules() is the one
+// place that turns such a name back into a type: f gets a value of the rule
+// type, so a generic lambda can instantiate whatever it needs.
+enum Variant { DrawOneVariant, DrawThreeVariant, DrawThreeVegasVariant, VariantCount };
+
+const char* const variantNames[VariantCount] = { "draw1", "draw3", "vegas" };
+
+inline bool parseVariant(const std::string& name, Variant& variant) {
+    for (int v = 0; v < VariantCount; ++v) {
+        if (name == variantNames[v]) {
+            variant = Variant(v);
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename F>
+auto withRules(Variant variant, F f) -> decltype(f(DrawOne())) {
+    switch (variant) {
+    case DrawThreeVariant:
+        return f(DrawThree());
+    case DrawThreeVegasVariant:
+        return f(DrawThreeVegas());
+    default:
+        return f(DrawOne());
+    }
+}
+
+// Enumerates every legal move of a position into a caller-supplied buffer,
+// with no allocation and no I/O. Stacking legality comes from a table built
+// once per rule set: stackOn[card] has bit `onto` set when card may go on onto.
+// Under AnyCard rules a run moves to an empty column only as a whole.
+template <typename Rules>
+class BasicMoveGenerator {
+public:
+    static const int MaxMoves = 64; // 42 tableau pairs + 7 + 7 + 2 at most (a draw and a recycle never coexist)
+
+    static bool canStack(uint8_t card, uint8_t onto) {
+        return (onto & Card::FaceUpBit) && ((tables.stackOn[card & Card::IdentityMask] >> (onto & Card::IdentityMask)) & 1);
+    }
+
+    static bool canFound(const GameState& s, uint8_t card) {
+        return s.foundation[card & 3] + 1 == ((card >> 2) & 0xF);
+    }
+
+    // Lowest index of the face-up run on top of tableau pile `i` that moves as a unit
+    static int runStart(const GameState& s, int i) {
+        const uint8_t* pile = s.tableau[i];
+        int run = s.tableauCount[i] - 1;
+        while (run > 0 && canStack(pile[run], pile[run - 1])) --run;
+        return run;
+    }
+
+    static int generateMoves(const GameState& s, Move* out) {
+        int n = 0;
+        uint8_t wasteTop = s.wasteTop();
+        if (wasteTop && canFound(s, wasteTop)) {
+            out[n++] = Move{ Move::WastePile, uint8_t(Move::FoundationPile + (wasteTop & 3)), 1, 0 };
+        }
+
+        for (int i = 0; i < 7; ++i) {
+            int count = s.tableauCount[i];
+            if (count == 0) continue;
+            const uint8_t* pile = s.tableau[i];
+            uint8_t top = pile[count - 1];
+            if (canFound(s, top)) {
+                out[n++] = Move{ uint8_t(i), uint8_t(Move::FoundationPile + (top & 3)), 1, 0 };
+            }
+
+            int run = runStart(s, i);
+            int runRank = Card(pile[run]).getRank();
+            for (int j = 0; j < 7; ++j) {
+                if (j == i) continue;
+                int target = s.tableauCount[j];
+                int k;
+                if (target == 0) {
+                    k = Rules::EmptyColumn == AnyCard || runRank == Card::King ? run : -1;
+                }
+                else {
+                    // Ranks fall by one up the run, so only one card can fit the target
+                    uint8_t onto = s.tableau[j][target - 1];
+                    k = run + runRank - (Card(onto).getRank() - 1);
+                    if (k < run || k >= count || !canStack(pile[k], onto)) k = -1;
+                }
+                if (k >= 0 && target + count - k <= GameState::MaxTableauCards) {
+                    out[n++] = Move{ uint8_t(i), uint8_t(j), uint8_t(count - k), 0 };
+                }
+            }
+        }
+
+        if (wasteTop) {
+            for (int j = 0; j < 7; ++j) {
+                int target = s.tableauCount[j];
+                bool fits = target == 0 ? Rules::EmptyColumn == AnyCard || Card(wasteTop).getRank() == Card::King
+                    : canStack(wasteTop, s.tableau[j][target - 1]);
+                if (fits && target < GameState::MaxTableauCards) {
+                    out[n++] = Move{ Move::WastePile, uint8_t(j), 1, 0 };
+                }
+            }
+        }
+
+        if (stockMove(s, out[n])) ++n;
+        return n;
+    }
+
+    // The draw of up to Rules::Draw cards, or once the stock is empty the
+    // recycle of the waste while redeals remain
+    static bool stockMove(const GameState& s, Move& m) {
+        if (s.stockCount()) {
+            m = Move{ Move::StockPile, Move::WastePile, uint8_t(std::min(Rules::Draw, s.stockCount())), 0 };
+            return true;
+        }
+        if (s.wasteCount && (Rules::Redeals < 0 || s.passes < Rules::Redeals)) {
+            m = Move{ Move::WastePile, Move::StockPile, s.wasteCount, uint8_t(Rules::Redeals >= 0) };
+            return true;
+        }
+        return false;
+    }
+
+    // The generated move with the same from, to and count as `m`, so that
+    // its other fields (whether a recycle uses up a redeal) come from the
+    // rules and not from the caller
+    static bool find(const GameState& s, const Move& m, Move& legal) {
+        Move moves[MaxMoves];
+        int n = generateMoves(s, moves);
+        for (int i = 0; i < n; ++i) {
+            if (moves[i].from == m.from && moves[i].to == m.to && moves[i].count == m.count) {
+                legal = moves[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether `m` is one of the moves generateMoves would produce
+    static bool isLegal(const GameState& s, const Move& m) {
+        Move legal;
+        return find(s, m, legal);
+    }
+
+private:
+    struct Tables {
+        uint64_t stackOn[Card::IdentityMask + 1];
+
+        Tables() {
+            for (int card = 0; card <= Card::IdentityMask; ++card) {
+                stackOn[card] = 0;
+                for (int onto = 0; onto <= Card::IdentityMask; ++onto) {
+                    Card c(static_cast<uint8_t>(card)), o(static_cast<uint8_t>(onto));
+                    bool suits = Rules::StackOn == AnySuit || (Rules::StackOn == SameSuit ? c.getSuit() == o.getSuit()
+                        : c.getColor() != o.getColor());
+                    if (c.getRank() >= Card::Ace && o.getRank() <= Card::King
+                        && suits && c.getRank() + 1 == o.getRank()) {
+                        stackOn[card] |= uint64_t(1) << onto;
+                    }
+                }
+            }
+        }
+    };
+
+    static const Tables tables;
+};
+
+template <typename Rules>
+const typename BasicMoveGenerator<Rules>::Tables BasicMoveGenerator<Rules>::tables;
+
+typedef BasicMoveGenerator<DrawOne> MoveGenerator;
+
+// Foundation moves that can never turn out wrong, played without asking.
+// A card is safe once nothing could ever need it in the tableau: an Ace or
+// a Two, or any card whose possible passengers (the rank below it that the
+// rule set lets stack on it) are all on their foundations already. The
+// waste top only counts when drawing one at a time; with larger draws
+// taking a card out of the waste shifts every later draw.
+//
+// Candidates come from the per-suit foundation heights and an index from
+// card to the pile it tops, built from the eight sources when a run of
+// auto-play starts and patched after every move of the run, so finding the
+// next safe move is O(1). A single lookup, as the solver makes once per
+// node, uses first() instead, which reads the sources without the index.
+template <typename Rules>
+class BasicAutoFoundation {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+
+    explicit BasicAutoFoundation(const GameState& s) {
+        std::memset(where, NoPile, sizeof(where));
+        for (int p = 0; p < GameState::TableauPiles; ++p) index(s, p);
+        index(s, Move::WastePile);
+    }
+
+    static bool isSafe(const GameState& s, uint8_t card) {
+        int rank = Card(card).getRank();
+        if (rank <= 2) return true;
+        for (int suit = 0; suit < 4; ++suit) {
+            uint8_t below = Card(suit, rank - 1).getCode() | Card::FaceUpBit;
+            if (MoveGenerator::canStack(below, card | Card::FaceUpBit) && s.foundation[suit] < rank - 1) return false;
+        }
+        return true;
+    }
+
+    // The next safe foundation move, if any
+    bool next(const GameState& s, Move& m) const {
+        for (int suit = 0; suit < 4; ++suit) {
+            if (s.foundation[suit] == Card::King) continue;
+            uint8_t card = Card(suit, s.foundation[suit] + 1).getCode();
+            uint8_t pile = where[card];
+            if (pile == NoPile || !isSafe(s, card)) continue;
+            m = Move{ pile, uint8_t(Move::FoundationPile + suit), 1, 0 };
+            return true;
+        }
+        return false;
+    }
+
+    // The first safe foundation move of `s`, if any, without an index
+    static bool first(const GameState& s, Move& m) {
+        for (int suit = 0; suit < 4; ++suit) {
+            if (s.foundation[suit] == Card::King) continue;
+            uint8_t card = Card(suit, s.foundation[suit] + 1).getCode();
+            int pile = locate(s, card);
+            if (pile < 0 || !isSafe(s, card)) continue;
+            m = Move{ uint8_t(pile), uint8_t(Move::FoundationPile + suit), 1, 0 };
+            return true;
+        }
+        return false;
+    }
+
+    // Call after `m` from next() was applied to `s`
+    void played(const GameState& s, const Move& m) {
+        where[Card(uint8_t(m.to - Move::FoundationPile), s.foundation[m.to - Move::FoundationPile]).getCode()] = NoPile;
+        index(s, m.from);
+    }
+
+private:
+    static const uint8_t NoPile = 0xFF;
+
+    // The card on top of `pile` that auto-play may take, or 0
+    static uint8_t top(const GameState& s, int pile) {
+        if (pile == Move::WastePile) return Rules::Draw == 1 ? s.wasteTop() : 0;
+        return s.tableauCount[pile] ? s.tableau[pile][s.tableauCount[pile] - 1] : 0;
+    }
+
+    // The pile `card` tops, or -1
+    static int locate(const GameState& s, uint8_t card) {
+        for (int p = 0; p < GameState::TableauPiles; ++p) {
+            if ((top(s, p) & Card::IdentityMask) == card) return p;
+        }
+        return (top(s, Move::WastePile) & Card::IdentityMask) == card ? int(Move::WastePile) : -1;
+    }
+
+    // Records the card now on top of `pile`
+    void index(const GameState& s, int pile) {
+        uint8_t card = top(s, pile);
+        if (card) where[card & Card::IdentityMask] = uint8_t(pile);
+    }
+
+    uint8_t where[Card::IdentityMask + 1];
+};
+
+typedef BasicAutoFoundation<DrawOne> AutoFoundation;
+
+// Proofs that a position can never be won, cheap enough to run before any
+// search. Every card off the foundations has to leave where it lies at some
+// point, and it can only go up to its foundation (after the lower cards of
+// its suit), onto a card it may stack on (once whatever covers that card has
+// moved) or into an empty column. Face-down cards, each column's lowest
+// face-up card and, on the last pass, the waste stay put until the card on
+// top of them has left. A card whose every way out needs something buried
+// under it is stuck for good, like a black Seven dealt over both red Eights
+// and its own Five.
+//
+// isBlocked() follows that order across the whole position: per card, the
+// set of cards that must leave before it, as a transitively closed 64-bit
+// mask. What all the ways out of a card still open have in common must
+// leave before it too, which chains columns and the talon together until
+// nothing changes. A card with no way out, or one that would have to leave
+// before itself, proves the position lost.
+//
+// strandedBy() is the per-node version. What lies under a card never
+// changes while it stays put, so a move can only strand the cards that just
+// lost a target to a foundation or were just covered in a last-pass waste.
+template <typename Rules>
+class BasicBlockDetector {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+
+    static bool isBlocked(const GameState& s) {
+        uint64_t before[Card::IdentityMask + 1] = {}; // cards that must leave first, closed transitively
+        uint8_t above[Card::IdentityMask + 1] = {};   // what covers a tableau card while it stays put
+        uint64_t held = 0, talon = 0;
+        for (int p = 0; p < GameState::TableauPiles; ++p) {
+            const uint8_t* pile = s.tableau[p];
+            if (s.tableauCount[p] == 0) continue;
+            int base = 0;
+            while (base < s.tableauCount[p] - 1 && !(pile[base] & Card::FaceUpBit)) ++base;
+            for (int i = base; i >= 0; --i) {
+                uint8_t card = pile[i] & Card::IdentityMask;
+                held |= bit(card);
+                if (i < base) {
+                    above[card] = pile[i + 1] & Card::IdentityMask;
+                    before[card] = before[above[card]] | bit(above[card]);
+                }
+            }
+        }
+        for (int i = s.talonCount - 1; i >= 0; --i) {
+            uint8_t card = s.talon[i] & Card::IdentityMask;
+            talon |= bit(card);
+            if (lastPass(s) && i + 1 < s.wasteCount) {
+                uint8_t cover = s.talon[i + 1] & Card::IdentityMask;
+                before[card] = before[cover] | bit(cover);
+            }
+        }
+        held |= talon;
+
+        // Per card, what each way out needs gone first. A way that needs
+        // nothing never closes, so such a card is settled from the start.
+        uint64_t ways[Card::IdentityMask + 1][MaxWays];
+        int wayCount[Card::IdentityMask + 1];
+        uint64_t open = 0;
+        for (uint64_t rest = held; rest; rest &= rest - 1) {
+            int card = __builtin_ctzll(rest);
+            int rank = card >> 2, n = 0;
+            uint64_t* need = ways[card];
+            need[n++] = lower(s, card) & held; // loose face-up cards can always get out of the way
+            for (int t = 0; t < 4 && rank < Card::King; ++t) {
+                uint8_t onto = Card(t, rank + 1).getCode();
+                if (s.foundation[t] > rank || !MoveGenerator::canStack(uint8_t(card | Card::FaceUpBit), onto | Card::FaceUpBit)) continue;
+                need[n++] = (talon >> onto) & 1 ? bit(onto) : above[onto] ? bit(above[onto]) : 0;
+            }
+            if (Rules::EmptyColumn == AnyCard || rank == Card::King) {
+                for (int p = 0; p < GameState::TableauPiles; ++p) {
+                    need[n++] = s.tableauCount[p] ? bit(s.tableau[p][0]) : 0;
+                }
+            }
+            wayCount[card] = n;
+            bool settled = false;
+            for (int k = 0; k < n; ++k) settled = settled || need[k] == 0;
+            if (!settled) open |= bit(card);
+        }
+
+        // What all the ways still open have in common must go first as
+        // well; adding that can close ways of other cards, so repeat
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint64_t rest = open; rest; rest &= rest - 1) {
+                int card = __builtin_ctzll(rest);
+                bool way = false;
+                uint64_t common = ~uint64_t(0);
+                for (int k = 0; k < wayCount[card]; ++k) {
+                    if (!canWait(before, card, ways[card][k])) continue;
+                    way = true;
+                    common &= ways[card][k];
+                }
+                if (!way) return true;
+
+                uint64_t added = common & ~before[card];
+                if (added == 0) continue;
+                for (uint64_t y = added; y; y &= y - 1) added |= before[__builtin_ctzll(y)];
+                before[card] |= added;
+                if ((before[card] >> card) & 1) return true; // it would have to leave before itself
+                for (uint64_t z = held; z; z &= z - 1) {
+                    int later = __builtin_ctzll(z);
+                    if ((before[later] >> card) & 1) before[later] |= before[card];
+                }
+                changed = true;
+            }
+        }
+        return false;
+    }
+
+    // Call after `m` was applied to `s`; true if it left a card with no way out
+    static bool strandedBy(const GameState& s, const Move& m) {
+        if (Move::isFoundation(m.to)) {
+            int suit = m.to - Move::FoundationPile, rank = s.foundation[suit];
+            uint8_t played = Card(suit, rank).getCode() | Card::FaceUpBit;
+            for (int t = 0; t < 4 && rank > Card::Ace; ++t) {
+                uint8_t card = Card(t, rank - 1).getCode();
+                uint64_t under;
+                if (s.foundation[t] < rank - 1 && MoveGenerator::canStack(card | Card::FaceUpBit, played)
+                    && mayStrand(s, card) && locate(s, card, under) && stranded(s, card, under)) return true;
+            }
+        }
+        else if (m.from == Move::StockPile && lastPass(s)) {
+            uint64_t under = 0;
+            for (int i = 0; i < s.wasteCount; ++i) {
+                uint8_t card = s.talon[i] & Card::IdentityMask;
+                if (i >= s.wasteCount - m.count && mayStrand(s, card) && stranded(s, card, under)) return true;
+                under |= bit(card);
+            }
+        }
+        return false;
+    }
+
+private:
+    static const int MaxWays = 12; // the foundation, four cards to stack on, seven empty columns
+
+    static uint64_t bit(uint8_t card) {
+        return uint64_t(1) << (card & Card::IdentityMask);
+    }
+
+    // No more turning the waste over, so it only ever comes off the top
+    static bool lastPass(const GameState& s) {
+        return Rules::Redeals >= 0 && s.passes >= Rules::Redeals;
+    }
+
+    // The cards of the suit between its foundation and `card`
+    static uint64_t lower(const GameState& s, int card) {
+        int suit = card & 3;
+        uint64_t ranks = (uint64_t(1) << (card & ~3)) - (uint64_t(1) << (4 * s.foundation[suit] + 4));
+        return ranks & (uint64_t(0x1111111111111111) << suit);
+    }
+
+    // Whether every card in `need` can leave before `card` does
+    static bool canWait(const uint64_t* before, int card, uint64_t need) {
+        if ((need >> card) & 1) return false;
+        for (uint64_t y = need; y; y &= y - 1) {
+            if ((before[__builtin_ctzll(y)] >> card) & 1) return false;
+        }
+        return true;
+    }
+
+    // Cards that can always get away: Kings (or anything, under AnyCard
+    // rules) have the empty columns, and the next card for a foundation has
+    // nothing lower in its suit left to wait for
+    static bool mayStrand(const GameState& s, uint8_t card) {
+        int rank = card >> 2;
+        return Rules::EmptyColumn == KingsOnly && rank != Card::King && s.foundation[card & 3] + 1 < rank;
+    }
+
+    // The cards under `card` while it stays put; false if it is loose
+    static bool locate(const GameState& s, uint8_t card, uint64_t& under) {
+        for (int p = 0; p < GameState::TableauPiles; ++p) {
+            const uint8_t* pile = s.tableau[p];
+            under = 0;
+            for (int i = 0; i < s.tableauCount[p]; ++i) {
+                if ((pile[i] & Card::IdentityMask) == card) return i == 0 || !(pile[i - 1] & Card::FaceUpBit); // or it rides on a run
+                under |= bit(pile[i]);
+            }
+        }
+        if (!lastPass(s)) return false;
+        under = 0;
+        for (int i = 0; i < s.wasteCount; ++i) {
+            if ((s.talon[i] & Card::IdentityMask) == card) return true;
+            under |= bit(s.talon[i]);
+        }
+        return false;
+    }
+
+    // The one-card version of isBlocked(): only what lies under `card` counts
+    static bool stranded(const GameState& s, uint8_t card, uint64_t under) {
+        int rank = card >> 2;
+        if ((lower(s, card) & under) == 0) return false;
+        for (int t = 0; t < 4; ++t) {
+            uint8_t onto = Card(t, rank + 1).getCode();
+            if (s.foundation[t] <= rank && MoveGenerator::canStack(uint8_t(card | Card::FaceUpBit), onto | Card::FaceUpBit)
+                && !((under >> onto) & 1)) return false;
+        }
+        return true;
+    }
+};
+
+typedef BasicBlockDetector<DrawOne> BlockDetector;
+
+// Headless depth-first Klondike solver. Children are searched in priority
+// order and every position reached goes into a hash-indexed transposition
+// table, so a position that has already been explored is never expanded
+// again. Moves are made and unmade in place through a MoveJournal. A start
+// BlockDetector proves lost is not searched at all, and children it shows
+// stranded are cut off. Nothing in here does I/O.
+//
+// The first pass leaves out the moves orderedMoves() drops. Only when it
+// runs dry is the search repeated over every legal move, with what is left
+// of the node budget, so Unwinnable is a proof and not a guess.
+template <typename Rules>
+class BasicSolver {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef BasicBlockDetector<Rules> BlockDetector;
+
+    static const int MaxDepth = MoveJournal::Capacity;
+
+    enum Status { Solved, Unwinnable, GaveUp };
+
+    struct Result {
+        Status status;
+        Move moves[MaxDepth];
+        int moveCount;
+        uint64_t nodes;
+        uint64_t pruned;  // children BlockDetector::strandedBy cut off
+        bool blocked;     // BlockDetector::isBlocked proved the start lost, nothing was searched
+        double seconds;
+    };
+
+    BasicSolver(int tableBits = 22, uint64_t limit = 5000000)
+        : table(new uint64_t[size_t(1) << tableBits]), mask((uint64_t(1) << tableBits) - 1),
+        nodeLimit(limit), nodes(0), pruned(0), aborted(false), complete(false), work(), journal(work) {}
+
+    ~BasicSolver() {
+        delete[] table;
+    }
+
+    BasicSolver(const BasicSolver&) = delete;
+    BasicSolver& operator=(const BasicSolver&) = delete;
+
+    void solve(const GameState& start, Result& result) {
+        auto begin = std::chrono::steady_clock::now();
+        nodes = 0;
+        pruned = 0;
+        aborted = false;
+        result.moveCount = 0;
+        result.blocked = BlockDetector::isBlocked(start);
+        bool won = false;
+        for (int pass = 0; pass < 2 && !result.blocked && !won && !aborted; ++pass) {
+            complete = pass == 1;
+            std::memset(table, 0, (mask + 1) * sizeof(uint64_t));
+            work = start;
+            journal.clear();
+            visit(start.hash);
+            won = search();
+        }
+        if (won) {
+            result.status = Solved;
+            result.moveCount = journal.getSize();
+            for (int i = 0; i < result.moveCount; ++i) {
+                result.moves[i] = journal.at(i);
+            }
+        }
+        else {
+            result.status = aborted ? GaveUp : Unwinnable;
+        }
+        result.nodes = nodes;
+        result.pruned = pruned;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    static bool isWon(const GameState& s) {
+        return s.foundation[0] + s.foundation[1] + s.foundation[2] + s.foundation[3] == 52;
+    }
+
+    // Legal moves in the order they should be tried, best first. Moves that
+    // cannot make progress (splitting a run without freeing a foundation
+    // card, shuffling a King that already heads its column) are dropped,
+    // and a safe foundation move, when there is one, is the only move.
+    // With `complete` those moves are kept as a tail after all the others,
+    // so that a search which runs out of moves has proved the position lost.
+    static int orderedMoves(const GameState& s, Move* out, bool complete = false) {
+        if (BasicAutoFoundation<Rules>::first(s, out[0])) return 1;
+        Move moves[MoveGenerator::MaxMoves];
+        int scores[MoveGenerator::MaxMoves];
+        int total = MoveGenerator::generateMoves(s, moves);
+        int n = 0;
+        for (int m = 0; m < total; ++m) {
+            int value = score(s, moves[m]);
+            if (value < 0 && !complete) continue;
+            int i = n++;
+            while (i > 0 && scores[i - 1] < value) {
+                out[i] = out[i - 1];
+                scores[i] = scores[i - 1];
+                --i;
+            }
+            out[i] = moves[m];
+            scores[i] = value;
+        }
+        return n;
+    }
+
+private:
+    // Records the position; false if it was already in the table
+    bool visit(uint64_t key) {
+        if (key == 0) key = 1; // 0 marks an empty table slot
+        uint64_t slot = key & mask;
+        for (int probe = 0; probe < 8; ++probe) {
+            uint64_t& entry = table[(slot + probe) & mask];
+            if (entry == key) return false;
+            if (entry == 0) {
+                entry = key;
+                return true;
+            }
+        }
+        table[slot] = key; // neighbourhood full, evict
+        return true;
+    }
+
+    static int score(const GameState& s, const Move& m) {
+        if (m.from == Move::StockPile) return 5;
+        if (m.to == Move::StockPile) return 1; // recycling is the last resort
+        if (m.from == Move::WastePile) return Move::isFoundation(m.to) ? 90 : 50;
+
+        const uint8_t* pile = s.tableau[m.from];
+        int k = s.tableauCount[m.from] - m.count; // lowest card moved
+        bool reveals = k > 0 && !Card(pile[k - 1]).isFaceUp();
+        if (Move::isFoundation(m.to)) return reveals ? 100 : 95;
+        if (k == 0) return s.tableauCount[m.to] == 0 ? -1 : 60;
+        if (reveals) return 80;
+        if (!MoveGenerator::canFound(s, pile[k - 1])) return -1;
+        return 10;
+    }
+
+    bool search() {
+        if (isWon(work)) return true;
+        if (journal.isFull() || nodes >= nodeLimit) {
+            aborted = true;
+            return false;
+        }
+
+        Move moves[MoveGenerator::MaxMoves];
+        int n = orderedMoves(work, moves, complete);
+        for (int i = 0; i < n; ++i) {
+            journal.apply(moves[i]);
+            Zobrist::verify(work);
+            if (visit(work.hash)) {
+                if (BlockDetector::strandedBy(work, moves[i])) {
+                    ++pruned; // stays in the table, so it is never looked at again
+                }
+                else {
+                    ++nodes;
+                    if (search()) return true;
+                    if (aborted && nodes >= nodeLimit) return false;
+                }
+            }
+            journal.undo();
+        }
+        return false;
+    }
+
+    uint64_t* table;
+    uint64_t mask;
+    uint64_t nodeLimit;
+    uint64_t nodes;
+    uint64_t pruned;
+    bool aborted;
+    bool complete; // searching every legal move, see orderedMoves()
+    GameState work;
+    MoveJournal journal;
+};
+
+typedef BasicSolver<DrawOne> Solver;
+
+// The same search on several threads for one hard deal. The root is first
+// expanded breadth-first, best moves first, into a few dozen subtrees per
+// thread; workers then claim subtrees from that queue through an atomic
+// cursor, so a thread whose subtree dies early steals the next unexplored
+// one instead of idling. All workers share one lock-free transposition
+// table, so a position any of them has reached is not expanded again.
+//
+// A table entry is one 64-bit word: the top 48 bits of the hash and the
+// depth the position was reached at in the low 16. Entries are claimed with
+// a compare-and-swap; when the probe window is full the deepest entry, the
+// one heading the smallest subtree, is overwritten. Losing an entry that
+// way only costs repeated work, never a wrong verdict. Like Solver, it
+// searches every legal move in a second pass before calling a deal lost.
+template <typename Rules>
+class BasicParallelSolver {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef BasicSolver<Rules> Solver;
+    typedef BasicBlockDetector<Rules> BlockDetector;
+    typedef typename Solver::Result Result;
+
+    static const int MaxDepth = Solver::MaxDepth;
+
+    // threads 0 means one per core
+    BasicParallelSolver(int threads = 0, int tableBits = 24, uint64_t limit = 5000000)
+        : threadCount(threads > 0 ? threads : std::max(1, int(std::thread::hardware_concurrency()))),
+        table(new std::atomic<uint64_t>[size_t(1) << tableBits]), mask((uint64_t(1) << tableBits) - 1),
+        nodeLimit(limit), tasks(new Task[MaxTasks]), spare(new Task[MaxTasks]), taskCount(0), complete(false) {}
+
+    ~BasicParallelSolver() {
+        delete[] table;
+        delete[] tasks;
+        delete[] spare;
+    }
+
+    BasicParallelSolver(const BasicParallelSolver&) = delete;
+    BasicParallelSolver& operator=(const BasicParallelSolver&) = delete;
+
+    int getThreads() const { return threadCount; }
+
+    void solve(const GameState& start, Result& result) {
+        auto begin = std::chrono::steady_clock::now();
+        nodes.store(0);
+        pruned.store(0);
+        next.store(0);
+        stop.store(false);
+        aborted.store(false);
+        solved.store(false);
+        result.moveCount = 0;
+        result.blocked = BlockDetector::isBlocked(start);
+        for (int pass = 0; pass < 2 && !result.blocked && !solved && !aborted; ++pass) {
+            complete = pass == 1;
+            next.store(0);
+            for (uint64_t i = 0; i <= mask; ++i) {
+                table[i].store(0, std::memory_order_relaxed);
+            }
+            if (split(start, result)) break;
+            std::thread* workers = new std::thread[threadCount];
+            for (int i = 0; i < threadCount; ++i) {
+                workers[i] = std::thread([this, &result]() { work(result); });
+            }
+            for (int i = 0; i < threadCount; ++i) {
+                workers[i].join();
+            }
+            delete[] workers;
+        }
+        result.status = solved ? Solver::Solved : aborted ? Solver::GaveUp : Solver::Unwinnable;
+        result.nodes = nodes;
+        result.pruned = pruned;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+private:
+    static const int MaxSplitDepth = 12;
+    static const int TasksPerThread = 32;
+    static const int MaxTasks = 4096;
+    static const int FlushEvery = 256; // nodes a worker counts before adding them to the total
+    static const uint64_t DepthMask = 0xFFFF;
+
+    // A subtree root and the moves that lead to it from the start
+    struct Task {
+        GameState state;
+        Move path[MaxSplitDepth];
+        int length;
+    };
+
+    struct Worker {
+        Worker() : work(), journal(work), task(nullptr), pending(0), pruned(0) {}
+
+        GameState work;
+        MoveJournal journal;
+        const Task* task;
+        uint64_t pending;
+        uint64_t pruned;
+    };
+
+    // Records the position; false if it was already in the table
+    bool visit(uint64_t hash, int depth) {
+        uint64_t tag = hash & ~DepthMask;
+        if (tag == 0) tag = DepthMask + 1; // 0 marks an empty table slot
+        uint64_t entry = tag | uint64_t(std::min(depth, int(DepthMask)));
+        uint64_t slot = hash & mask;
+        uint64_t victim = slot, victimDepth = 0;
+        for (int probe = 0; probe < 8; ++probe) {
+            std::atomic<uint64_t>& cell = table[(slot + probe) & mask];
+            uint64_t current = cell.load(std::memory_order_relaxed);
+            while (current == 0 && !cell.compare_exchange_weak(current, entry, std::memory_order_relaxed)) {}
+            if (current == 0) return true;
+            if ((current & ~DepthMask) == tag) return false;
+            if ((current & DepthMask) >= victimDepth) {
+                victim = (slot + probe) & mask;
+                victimDepth = current & DepthMask;
+            }
+        }
+        table[victim].store(entry, std::memory_order_relaxed); // neighbourhood full, evict the deepest
+        return true;
+    }
+
+    // Expands the root until there are enough subtrees to keep every thread
+    // busy; true if a win turned up on the way. A parent whose children
+    // would not fit is kept as a subtree of its own.
+    bool split(const GameState& start, Result& result) {
+        tasks[0].state = start;
+        tasks[0].length = 0;
+        taskCount = 1;
+        visit(start.hash, 0);
+        if (Solver::isWon(start)) {
+            solved = true;
+            return true;
+        }
+
+        for (int depth = 0; depth < MaxSplitDepth && taskCount > 0 && taskCount < threadCount * TasksPerThread; ++depth) {
+            int n = 0;
+            for (int t = 0; t < taskCount; ++t) {
+                const Task& task = tasks[t];
+                if (n + MoveGenerator::MaxMoves > MaxTasks) {
+                    spare[n++] = task;
+                    continue;
+                }
+                Move moves[MoveGenerator::MaxMoves];
+                int count = Solver::orderedMoves(task.state, moves, complete);
+                for (int i = 0; i < count; ++i) {
+                    Task& child = spare[n];
+                    child.state = task.state;
+                    MoveJournal::apply(child.state, moves[i]);
+                    if (!visit(child.state.hash, task.length + 1)) continue;
+                    if (BlockDetector::strandedBy(child.state, moves[i])) {
+                        pruned.fetch_add(1, std::memory_order_relaxed);
+                        continue;
+                    }
+                    std::memcpy(child.path, task.path, task.length * sizeof(Move));
+                    child.path[task.length] = moves[i];
+                    child.length = task.length + 1;
+                    nodes.fetch_add(1, std::memory_order_relaxed);
+                    if (Solver::isWon(child.state)) {
+                        result.moveCount = child.length;
+                        std::memcpy(result.moves, child.path, child.length * sizeof(Move));
+                        solved = true;
+                        return true;
+                    }
+                    ++n;
+                }
+            }
+            std::swap(tasks, spare);
+            taskCount = n;
+        }
+        return false;
+    }
+
+    void work(Result& result) {
+        Worker* worker = new Worker;
+        while (!stop.load(std::memory_order_relaxed)) {
+            int i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= taskCount) break;
+            worker->task = &tasks[i];
+            worker->work = tasks[i].state;
+            worker->journal.clear();
+            if (search(*worker, result)) break;
+        }
+        nodes.fetch_add(worker->pending, std::memory_order_relaxed);
+        pruned.fetch_add(worker->pruned, std::memory_order_relaxed);
+        delete worker;
+    }
+
+    // True once this worker is done: it won, or another one stopped the search
+    bool search(Worker& w, Result& result) {
+        if (Solver::isWon(w.work)) {
+            report(w, result);
+            return true;
+        }
+        int depth = w.task->length + w.journal.getSize();
+        if (depth == MaxDepth) {
+            aborted = true;
+            return false;
+        }
+
+        Move moves[MoveGenerator::MaxMoves];
+        int n = Solver::orderedMoves(w.work, moves, complete);
+        for (int i = 0; i < n; ++i) {
+            w.journal.apply(moves[i]);
+            Zobrist::verify(w.work);
+            if (visit(w.work.hash, depth + 1)) {
+                if (BlockDetector::strandedBy(w.work, moves[i])) {
+                    ++w.pruned;
+                    w.journal.undo();
+                    continue;
+                }
+                if (++w.pending == FlushEvery) {
+                    w.pending = 0;
+                    if (nodes.fetch_add(FlushEvery, std::memory_order_relaxed) + FlushEvery >= nodeLimit) {
+                        aborted = true;
+                        stop = true;
+                    }
+                }
+                if (stop.load(std::memory_order_relaxed) || search(w, result)) return true;
+            }
+            w.journal.undo();
+        }
+        return false;
+    }
+
+    // The first worker to win writes the line; everyone else winds down
+    void report(const Worker& w, Result& result) {
+        bool expected = false;
+        if (!solved.compare_exchange_strong(expected, true)) return;
+        result.moveCount = w.task->length + w.journal.getSize();
+        std::memcpy(result.moves, w.task->path, w.task->length * sizeof(Move));
+        for (int i = 0; i < w.journal.getSize(); ++i) {
+            result.moves[w.task->length + i] = w.journal.at(i);
+        }
+        stop = true;
+    }
+
+    int threadCount;
+    std::atomic<uint64_t>* table;
+    uint64_t mask;
+    uint64_t nodeLimit;
+    Task* tasks;
+    Task* spare;
+    int taskCount;
+    std::atomic<uint64_t> nodes;
+    std::atomic<uint64_t> pruned;
+    std::atomic<int> next;
+    std::atomic<bool> stop;
+    std::atomic<bool> aborted;
+    std::atomic<bool> solved;
+    bool complete; // set before the workers start, see Solver::orderedMoves()
+};
+
+typedef BasicParallelSolver<DrawOne> ParallelSolver;
+
+// Best-next-move search with a hard wall-clock budget. Iterative deepening
+// over Solver::orderedMoves: each finished depth replaces the answer, and the
+// current depth's best is kept once the previous best has been re-searched
+// first. Positions are scored by evaluate(). The table and every buffer are
+// allocated once, so a hint allocates nothing and takes the budget at most.
+template <typename Rules>
+class BasicHintEngine {
+public:
+    typedef BasicMoveGenerator<Rules> MoveGenerator;
+    typedef BasicSolver<Rules> Solver;
+    typedef BasicBlockDetector<Rules> BlockDetector;
+
+    static const int MaxDepth = 48;
+    static const int TableBits = 16;
+    static const int WinScore = 1000000;
+
+    struct Hint {
+        bool found;
+        Move move;
+        int score;
+        int depth; // deepest iteration that contributed
+        uint64_t nodes;
+        double seconds;
+    };
+
+    BasicHintEngine() : table(new Entry[size_t(1) << TableBits]()), generation(0), nodes(0), deadline(), aborted(false), ply(0) {}
+
+    ~BasicHintEngine() {
+        delete[] table;
+    }
+
+    BasicHintEngine(const BasicHintEngine&) = delete;
+    BasicHintEngine& operator=(const BasicHintEngine&) = delete;
+
+    // Heuristic value of a position: foundation progress first, then every
+    // face-down card still buried, then empty columns waiting for a King
+    static int evaluate(const GameState& s) {
+        if (Solver::isWon(s)) return WinScore;
+        int value = 100 * (s.foundation[0] + s.foundation[1] + s.foundation[2] + s.foundation[3]);
+        for (int i = 0; i < 7; ++i) {
+            int count = s.tableauCount[i];
+            if (count == 0) {
+                value += 15;
+                continue;
+            }
+            int faceDown = 0;
+            while (faceDown < count && !(s.tableau[i][faceDown] & Card::FaceUpBit)) ++faceDown;
+            value -= 40 * faceDown;
+        }
+        return value;
+    }
+
+    void hint(const GameState& start, std::chrono::nanoseconds budget, Hint& result) {
+        auto begin = std::chrono::steady_clock::now();
+        deadline = begin + budget;
+        aborted = false;
+        nodes = 0;
+        ++generation;
+        work = start;
+        ply = 0;
+        path[0] = work.hash;
+
+        result.found = false;
+        result.depth = 0;
+        result.score = evaluate(work);
+        Move rootMoves[MoveGenerator::MaxMoves];
+        int n = Solver::orderedMoves(work, rootMoves);
+        if (n == 0) n = MoveGenerator::generateMoves(work, rootMoves); // only pointless moves left; still offer one
+        if (n > 0) {
+            result.found = true;
+            result.move = rootMoves[0];
+        }
+
+        for (int depth = 1; depth <= MaxDepth && n > 1 && !aborted; ++depth) {
+            int best = -WinScore * 2, bestIndex = -1;
+            for (int i = 0; i < n; ++i) {
+                int value = child(rootMoves[i], depth - 1);
+                if (aborted) break;
+                if (value > best) {
+                    best = value;
+                    bestIndex = i;
+                }
+            }
+            if (bestIndex < 0) break; // nothing finished at this depth
+            if (aborted && bestIndex == 0 && depth > 1) break; // only re-confirmed the old answer
+            result.move = rootMoves[bestIndex];
+            result.score = best;
+            result.depth = depth;
+            // The best move leads the next iteration
+            Move m = rootMoves[bestIndex];
+            for (int i = bestIndex; i > 0; --i) rootMoves[i] = rootMoves[i - 1];
+            rootMoves[0] = m;
+            if (best >= WinScore - MaxDepth) break; // a forced win is as good as it gets
+        }
+        if (n == 1) {
+            result.depth = 1;
+        }
+
+        result.nodes = nodes;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+private:
+    struct Entry {
+        uint64_t key;
+        int32_t value;
+        uint16_t depth;
+        uint16_t generation;
+    };
+
+    // Applies m, scores the result to the given depth and takes m back
+    int child(Move m, int depth) {
+        MoveJournal::apply(work, m);
+        int value;
+        bool repeated = false;
+        for (int i = 0; i <= ply && !repeated; ++i) repeated = path[i] == work.hash;
+        if (repeated) {
+            value = -WinScore * 2; // going round in circles is never the answer
+        }
+        else if (BlockDetector::strandedBy(work, m)) {
+            value = -WinScore; // lost for sure, whatever evaluate() thinks of it
+        }
+        else {
+            path[++ply] = work.hash;
+            value = search(depth) - 1; // a gain sooner beats the same gain later
+            --ply;
+        }
+        MoveJournal::revert(work, m);
+        return value;
+    }
+
+    // Best score reachable within `depth` moves, stopping early being allowed
+    int search(int depth) {
+        if ((++nodes & 63) == 0 && std::chrono::steady_clock::now() >= deadline) aborted = true;
+        int value = evaluate(work);
+        if (aborted || depth == 0 || value == WinScore) return value;
+
+        Entry& entry = table[work.hash & ((uint64_t(1) << TableBits) - 1)];
+        if (entry.key == work.hash && entry.generation == generation && entry.depth >= depth) return entry.value;
+
+        Move moves[MoveGenerator::MaxMoves];
+        int n = Solver::orderedMoves(work, moves);
+        for (int i = 0; i < n && !aborted; ++i) {
+            value = std::max(value, child(moves[i], depth - 1));
+        }
+        if (!aborted) {
+            entry.key = work.hash;
+            entry.value = value;
+            entry.depth = uint16_t(depth);
+            entry.generation = uint16_t(generation);
+        }
+        return value;
+    }
+
+    Entry* table;
+    uint32_t generation;
+    uint64_t nodes;
+    std::chrono::steady_clock::time_point deadline;
+    bool aborted;
+    GameState work;
+    uint64_t path[MaxDepth + 1];
+    int ply;
+};
+
+typedef BasicHintEngine<DrawOne> HintEngine;
+
+// The engine's small, stable face for embedding: one game under one rule
+// set, moves in and status out, nothing printed. Creating one deals the
+// game into a GameState held by value; apply() checks a move against the
+// generator, plays it in O(1) and keeps it for undo(). Piles are numbered
+// as in Move, and a draw's count is min(draw count, stock left).
+class Engine {
+public:
+    enum Status { Playing, Won, Stuck }; // Stuck: no legal move is left
+
+    static const int MaxMoves = MoveGenerator::MaxMoves; // what legalMoves() may write
+    static const int MaxHistory = MoveJournal::Capacity;
+
+    explicit Engine(uint64_t number = 0, Variant variant = DrawOneVariant)
+        : rules(variant), dealNumber(number), state(), journal(state) {
+        newDeal(state, number);
+    }
+
+    Engine(const Engine&) = delete;
+    Engine& operator=(const Engine&) = delete;
+
+    void deal(uint64_t number) {
+        dealNumber = number;
+        newDeal(state, number);
+        journal.clear();
+    }
+
+    int legalMoves(Move* out) const {
+        return withRules(rules, [&](auto r) { return BasicMoveGenerator<decltype(r)>::generateMoves(state, out); });
+    }
+
+    bool isLegal(const Move& m) const {
+        return withRules(rules, [&](auto r) { return BasicMoveGenerator<decltype(r)>::isLegal(state, m); });
+    }
+
+    // False, with nothing changed, for an illegal move or a full history.
+    // Only from, to and count are read from `m`; the generator's own move is
+    // the one played.
+    bool apply(const Move& m) {
+        Move legal;
+        if (journal.isFull() || !withRules(rules, [&](auto r) { return BasicMoveGenerator<decltype(r)>::find(state, m, legal); })) {
+            return false;
+        }
+        journal.apply(legal);
+        return true;
+    }
+
+    // Every foundation move BasicAutoFoundation can prove safe; returns how many
+    int playSafeMoves() {
+        return withRules(rules, [&](auto r) {
+            BasicAutoFoundation<decltype(r)> safe(state);
+            Move m;
+            int n = 0;
+            while (!journal.isFull() && safe.next(state, m)) {
+                journal.apply(m);
+                safe.played(state, m);
+                ++n;
+            }
+            return n;
+        });
+    }
+
+    bool undo() {
+        if (journal.getSize() == 0) return false;
+        journal.undo();
+        return true;
+    }
+
+    // True when BlockDetector can prove the position lost; it may still have moves
+    bool isBlocked() const {
+        return withRules(rules, [&](auto r) { return BasicBlockDetector<decltype(r)>::isBlocked(state); });
+    }
+
+    Status status() const {
+        if (BasicSolver<DrawOne>::isWon(state)) return Won;
+        Move moves[MaxMoves];
+        return legalMoves(moves) ? Playing : Stuck;
+    }
+
+    // A position together with the deal it came from
+    struct Snapshot {
+        GameState state;
+        uint64_t dealNumber;
+    };
+
+    // The whole position as one struct copy; restoring drops the history and
+    // goes back to the snapshot's deal, even after deal() moved on
+    Snapshot snapshot() const {
+        return Snapshot{ state, dealNumber };
+    }
+
+    void restore(const Snapshot& position) {
+        state = position.state;
+        dealNumber = position.dealNumber;
+        journal.clear();
+    }
+
+    const GameState& getState() const { return state; }
+    uint64_t getDealNumber() const { return dealNumber; }
+    Variant getRules() const { return rules; }
+    int getMoveCount() const { return journal.getSize(); }
+
+private:
+    Variant rules;
+    uint64_t dealNumber;
+    GameState state;
+    MoveJournal journal;
+};
+
+} // namespace solitaire
+
+#endif // SOLITAIRE_ENGINE_H